@@ -0,0 +1,203 @@
+/*
+    Telemetry encoding into a caller owned buffer, CBOR (RFC 8949) or JSON, no heap allocation.
+
+    The schema is an X macro list of (type, name) pairs, TELEMETRY_STRUCT turns it into a struct
+    with an encode() that writes every field as a map entry keyed by its name:
+
+        #define SENSOR_FIELDS(X) \
+            X(uint32_t, uptime)  \
+            X(float, temp)
+        TELEMETRY_STRUCT(Sensor, SENSOR_FIELDS);
+
+        uint8_t buf[64];
+        Sensor  s = {millis(), 21.5};
+        size_t  len = s.encode(buf, sizeof(buf), TELEMETRY_CBOR);  // 0 if it did not fit
+*/
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+enum TelemetryFormat { TELEMETRY_CBOR, TELEMETRY_JSON };
+
+//----------------- CBOR ----------------------//
+class CborWriter {
+   public:
+    CborWriter(uint8_t* buf, size_t size) : _buf(buf), _size(size) {}
+
+    void beginMap(size_t count) { head(5, count); }
+    void endMap() {}
+    void key(const char* k) { text(k); }
+
+    void value(bool v) { put(v ? 0xf5 : 0xf4); }
+    void value(uint32_t v) { head(0, v); }
+    void value(int32_t v) { v < 0 ? head(1, (uint32_t)(-1 - v)) : head(0, (uint32_t)v); }
+    void value(uint16_t v) { value((uint32_t)v); }
+    void value(int16_t v) { value((int32_t)v); }
+    void value(uint8_t v) { value((uint32_t)v); }
+    void value(int8_t v) { value((int32_t)v); }
+    void value(const char* v) { text(v); }
+    void value(float v) {
+        uint32_t bits;
+        memcpy(&bits, &v, 4);
+        put(0xfa);
+        put(bits >> 24);
+        put(bits >> 16);
+        put(bits >> 8);
+        put(bits);
+    }
+
+    // bytes written, 0 if the buffer was too small
+    size_t length() const { return _overflow ? 0 : _len; }
+
+   private:
+    uint8_t* _buf;
+    size_t   _size;
+    size_t   _len      = 0;
+    bool     _overflow = false;
+
+    void put(uint8_t b) {
+        if (_len < _size) _buf[_len++] = b;
+        else _overflow = true;
+    }
+
+    // major type and argument, shortest form
+    void head(uint8_t major, uint32_t arg) {
+        major <<= 5;
+        if (arg < 24) {
+            put(major | arg);
+        } else if (arg <= 0xff) {
+            put(major | 24);
+            put(arg);
+        } else if (arg <= 0xffff) {
+            put(major | 25);
+            put(arg >> 8);
+            put(arg);
+        } else {
+            put(major | 26);
+            put(arg >> 24);
+            put(arg >> 16);
+            put(arg >> 8);
+            put(arg);
+        }
+    }
+
+    void text(const char* s) {
+        size_t n = strlen(s);
+        head(3, n);
+        if (_len + n > _size) {
+            _overflow = true;
+            return;
+        }
+        memcpy(_buf + _len, s, n);
+        _len += n;
+    }
+};
+
+//----------------- JSON ----------------------//
+// fallback for consumers without a CBOR decoder, floats are written with 2 decimals
+class JsonWriter {
+   public:
+    JsonWriter(uint8_t* buf, size_t size) : _buf(buf), _size(size) {}
+
+    void beginMap(size_t count) { put('{'); }
+    void endMap() { put('}'); }
+    void key(const char* k) {
+        if (_fields++) put(',');
+        text(k);
+        put(':');
+    }
+
+    void value(bool v) { raw(v ? "true" : "false"); }
+    void value(uint32_t v) { number(v, false); }
+    void value(int32_t v) { v < 0 ? number((uint32_t)(-(int64_t)v), true) : number((uint32_t)v, false); }
+    void value(uint16_t v) { value((uint32_t)v); }
+    void value(int16_t v) { value((int32_t)v); }
+    void value(uint8_t v) { value((uint32_t)v); }
+    void value(int8_t v) { value((int32_t)v); }
+    void value(const char* v) { text(v); }
+    void value(float v) {
+        if (isnan(v) || isinf(v) || fabsf(v) >= 4.2e7f) {  // hundredths must fit in uint32_t
+            raw("null");
+            return;
+        }
+        uint32_t hundredths = (uint32_t)(fabsf(v) * 100.0f + 0.5f);
+        number(hundredths / 100, v < 0 && hundredths);
+        put('.');
+        put('0' + hundredths / 10 % 10);
+        put('0' + hundredths % 10);
+    }
+
+    // bytes written, 0 if the buffer was too small
+    size_t length() const { return _overflow ? 0 : _len; }
+
+   private:
+    uint8_t* _buf;
+    size_t   _size;
+    size_t   _len      = 0;
+    uint16_t _fields   = 0;
+    bool     _overflow = false;
+
+    void put(char c) {
+        if (_len < _size) _buf[_len++] = c;
+        else _overflow = true;
+    }
+
+    void raw(const char* s) {
+        while (*s) put(*s++);
+    }
+
+    void number(uint32_t v, bool negative) {
+        char   digits[10];
+        size_t n = 0;
+        do {
+            digits[n++] = '0' + v % 10;
+            v /= 10;
+        } while (v);
+        if (negative) put('-');
+        while (n) put(digits[--n]);
+    }
+
+    void text(const char* s) {
+        put('"');
+        for (; *s; s++) {
+            if (*s == '"' || *s == '\\') put('\\');
+            if ((uint8_t)*s >= 0x20) put(*s);
+        }
+        put('"');
+    }
+};
+
+//----------------- Schema --------------------//
+#define TELEMETRY_MEMBER(type, name) type name;
+#define TELEMETRY_COUNT(type, name) +1
+#define TELEMETRY_ENCODE(type, name) \
+    w.key(#name);                    \
+    w.value(name);
+
+#define TELEMETRY_STRUCT(Name, FIELDS)                                                  \
+    struct Name {                                                                       \
+        FIELDS(TELEMETRY_MEMBER)                                                        \
+        static const size_t fieldCount = 0 FIELDS(TELEMETRY_COUNT);                     \
+        template <class W>                                                              \
+        void encode(W& w) const {                                                       \
+            w.beginMap(fieldCount);                                                     \
+            FIELDS(TELEMETRY_ENCODE)                                                    \
+            w.endMap();                                                                 \
+        }                                                                               \
+        size_t encode(uint8_t* buf, size_t size, TelemetryFormat format) const {        \
+            if (format == TELEMETRY_JSON) {                                             \
+                JsonWriter w(buf, size);                                                \
+                encode(w);                                                              \
+                return w.length();                                                      \
+            }                                                                           \
+            CborWriter w(buf, size);                                                    \
+            encode(w);                                                                  \
+            return w.length();                                                          \
+        }                                                                               \
+    }
+
+#endif
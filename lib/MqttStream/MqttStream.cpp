@@ -0,0 +1,545 @@
+#include "MqttStream.h"
+
+// fixed header packet types
+#define MQTT_CONNECT 0x10
+#define MQTT_CONNACK 0x20
+#define MQTT_PUBLISH 0x30
+#define MQTT_PUBACK 0x40
+#define MQTT_SUBSCRIBE 0x82
+#define MQTT_SUBACK 0x90
+#define MQTT_UNSUBSCRIBE 0xa2
+#define MQTT_PINGREQ 0xc0
+#define MQTT_PINGRESP 0xd0
+#define MQTT_DISCONNECT 0xe0
+
+MqttStream::MqttStream(Client& client) : _client(client) {}
+
+MqttStream& MqttStream::setServer(const char* host, uint16_t port) {
+    _host = host;
+    _port = port;
+    return *this;
+}
+
+MqttStream& MqttStream::setCallback(MessageCallback callback) {
+    _callback = callback;
+    return *this;
+}
+
+MqttStream& MqttStream::setFragmentCallback(FragmentCallback callback) {
+    _fragmentCallback = callback;
+    return *this;
+}
+
+MqttStream& MqttStream::setAckCallback(AckCallback callback) {
+    _ackCallback = callback;
+    return *this;
+}
+
+MqttStream& MqttStream::setKeepAlive(uint16_t seconds) {
+    _keepAlive = seconds;
+    return *this;
+}
+
+MqttStream& MqttStream::setSocketTimeout(uint16_t seconds) {
+    _socketTimeout = seconds;
+    return *this;
+}
+
+MqttStream& MqttStream::setCleanSession(bool cleanSession) {
+    _cleanSession = cleanSession;
+    return *this;
+}
+
+MqttStream& MqttStream::setInflightWindow(uint8_t window) {
+    _inflightWindow = constrain(window, 1, MQTT_STREAM_INFLIGHT);
+    return *this;
+}
+
+//----------------- Connection ----------------//
+bool MqttStream::connect(const char* id, const char* user, const char* pass) {
+    if (connected()) return true;
+    lost(MQTT_DISCONNECTED);  // clears whatever a dropped connection left behind
+
+    if (!_host || !_client.connect(_host, _port)) {
+        _state = MQTT_CONNECT_FAILED;
+        return false;
+    }
+
+    static const uint8_t protocol[] = {0, 4, 'M', 'Q', 'T', 'T', 4};
+    uint8_t              flags      = _cleanSession ? 0x02 : 0;
+    uint32_t             remaining  = sizeof(protocol) + 3 + 2 + strlen(id);
+    if (user) {
+        flags |= 0x80;
+        remaining += 2 + strlen(user);
+    }
+    if (pass) {
+        flags |= 0x40;
+        remaining += 2 + strlen(pass);
+    }
+    stageHeader(MQTT_CONNECT, remaining);
+    stage(protocol, sizeof(protocol));
+    stageByte(flags);
+    stageByte(_keepAlive >> 8);
+    stageByte(_keepAlive & 0xff);
+    stageString(id);
+    if (user) stageString(user);
+    if (pass) stageString(pass);
+    if (!sendPacket()) {
+        _state = MQTT_CONNECT_FAILED;
+        return false;
+    }
+
+    unsigned long start = millis();
+    _connack            = false;
+    _sessionPresent     = false;
+    while (!_connack) {
+        if (!_client.connected() || millis() - start >= _socketTimeout * 1000UL) {
+            lost(MQTT_CONNECTION_TIMEOUT);
+            return false;
+        }
+        receive();
+        if (!_connack) delay(1);
+    }
+    if (_connackCode) {
+        lost(_connackCode);
+        return false;
+    }
+
+    _state           = MQTT_CONNECTED;
+    _pingOutstanding = false;
+    _lastIn = _lastOut = millis();
+    if (!_sessionPresent) {
+        for (uint8_t i = 0; i < _subscriptionCount; i++) _subscriptions[i].confirmed = false;
+    }
+    return resubscribe() && resend();
+}
+
+void MqttStream::disconnect() {
+    if (connected() && !_pubActive) {
+        stageByte(MQTT_DISCONNECT);
+        stageByte(0);
+        sendPacket();
+    }
+    lost(MQTT_DISCONNECTED);
+}
+
+bool MqttStream::connected() {
+    if (_state != MQTT_CONNECTED) return false;
+    if (_client.connected()) return true;
+    lost(MQTT_CONNECTION_LOST);
+    return false;
+}
+
+bool MqttStream::loop() {
+    if (!connected()) return false;
+    receive();
+    if (_state != MQTT_CONNECTED) return false;
+
+    unsigned long now       = millis();
+    unsigned long keepAlive = _keepAlive * 1000UL;
+    if (_inflightCount && _inflight[0].sent && now - _inflight[0].time >= _socketTimeout * 1000UL) {
+        lost(MQTT_CONNECTION_TIMEOUT);  // the broker stopped acking, resend() retries on the next connection
+        return false;
+    }
+    if (!keepAlive || _pubActive) return true;
+    if (_pingOutstanding) {
+        if (now - _lastIn >= keepAlive + keepAlive / 2) {
+            lost(MQTT_CONNECTION_TIMEOUT);
+            return false;
+        }
+    } else if (now - _lastOut >= keepAlive || now - _lastIn >= keepAlive) {
+        stageByte(MQTT_PINGREQ);
+        stageByte(0);
+        if (!sendPacket()) return false;
+        _pingOutstanding = true;
+    }
+    return true;
+}
+
+// drops the socket and everything tied to it, QoS 1 publishes still awaiting PUBACK are kept for
+// resend() when the session is persistent, otherwise the broker forgets them too and they are reported as not acked
+void MqttStream::lost(int state) {
+    _client.stop();
+    _state     = state;
+    _rxState   = RX_TYPE;
+    _pubActive = false;
+    _staged    = 0;
+    _sendOk    = true;
+    if (_cleanSession) {
+        while (_inflightCount) drop(0, false);
+    }
+}
+
+// after CONNACK, queued and unacknowledged publishes go out again in their original order
+bool MqttStream::resend() {
+    for (uint8_t i = 0; i < _inflightCount;) {
+        if (!_inflight[i].topic) {
+            drop(i, false);  // streamed, the payload is gone
+            continue;
+        }
+        if (!sendPublish(_inflight[i++])) return false;
+    }
+    return true;
+}
+
+//----------------- Outbound ------------------//
+// skips 0 and ids still awaiting PUBACK
+uint16_t MqttStream::nextPacketId() {
+    for (;;) {
+        if (++_nextId == 0) _nextId = 1;
+        uint8_t i = 0;
+        while (i < _inflightCount && _inflight[i].id != _nextId) i++;
+        if (i == _inflightCount) return _nextId;
+    }
+}
+
+// small pieces are gathered in _stage, a piece that does not fit is written from caller memory
+void MqttStream::stage(const uint8_t* data, size_t length) {
+    if (!_sendOk) return;
+    if (_staged + length > sizeof(_stage)) {
+        if (_staged && _client.write(_stage, _staged) != _staged) _sendOk = false;
+        _staged = 0;
+        if (length > sizeof(_stage)) {
+            if (_sendOk && _client.write(data, length) != length) _sendOk = false;
+            return;
+        }
+    }
+    memcpy(_stage + _staged, data, length);
+    _staged += length;
+}
+
+void MqttStream::stageString(const char* s) {
+    size_t length = strlen(s);
+    stageByte(length >> 8);
+    stageByte(length & 0xff);
+    stage((const uint8_t*)s, length);
+}
+
+void MqttStream::stageHeader(uint8_t type, uint32_t remaining) {
+    stageByte(type);
+    do {
+        uint8_t b = remaining & 0x7f;
+        remaining >>= 7;
+        stageByte(remaining ? b | 0x80 : b);
+    } while (remaining);
+}
+
+// ends a packet, a failed write leaves the stream unusable so the connection is dropped
+bool MqttStream::sendPacket() {
+    if (_sendOk && _staged && _client.write(_stage, _staged) != _staged) _sendOk = false;
+    _staged  = 0;
+    _lastOut = millis();
+    if (_sendOk) return true;
+    lost(MQTT_CONNECTION_LOST);
+    return false;
+}
+
+bool MqttStream::publish(const char* topic, const uint8_t* payload, size_t length, bool retained, uint8_t qos) {
+    if (qos != 1) {
+        if (!beginPublish(topic, length, retained, qos)) return false;
+        write(payload, length);
+        return endPublish();
+    }
+    if (_pubActive || _inflightCount >= _inflightWindow) return false;
+    bool online = connected();
+    if (!online && _cleanSession) return false;
+
+    _packetId     = nextPacketId();
+    Inflight& msg = _inflight[_inflightCount++];
+    msg           = {_packetId, false, retained, 0, topic, payload, length};
+    if (online) sendPublish(msg);
+    return _state == MQTT_CONNECTED || !_cleanSession;
+}
+
+bool MqttStream::publish(const char* topic, const char* payload, bool retained) {
+    return publish(topic, (const uint8_t*)payload, strlen(payload), retained);
+}
+
+// DUP is set when the broker may have seen the packet before
+bool MqttStream::sendPublish(Inflight& msg) {
+    stageHeader(MQTT_PUBLISH | (msg.sent ? 0x08 : 0) | 0x02 | (msg.retained ? 1 : 0), 2 + strlen(msg.topic) + 2 + msg.length);
+    stageString(msg.topic);
+    stageByte(msg.id >> 8);
+    stageByte(msg.id & 0xff);
+    stage(msg.payload, msg.length);
+    msg.sent = true;
+    msg.time = millis();
+    return sendPacket();
+}
+
+bool MqttStream::beginPublish(const char* topic, size_t length, bool retained, uint8_t qos) {
+    if (_pubActive || qos > 1 || !connected()) return false;
+    if (qos && _inflightCount >= _inflightWindow) return false;
+
+    stageHeader(MQTT_PUBLISH | qos << 1 | (retained ? 1 : 0), 2 + strlen(topic) + (qos ? 2 : 0) + length);
+    stageString(topic);
+    if (qos) {
+        _packetId = nextPacketId();
+        stageByte(_packetId >> 8);
+        stageByte(_packetId & 0xff);
+    }
+    _pubActive = true;
+    _pubLeft   = length;
+    _pubQos    = qos;
+    return true;
+}
+
+size_t MqttStream::write(uint8_t b) {
+    return write(&b, 1);
+}
+
+// anything past the length given to beginPublish() is refused, it would be read as the next packet
+size_t MqttStream::write(const uint8_t* buf, size_t size) {
+    if (!_pubActive) return 0;
+    if (size > _pubLeft) size = _pubLeft;
+    stage(buf, size);
+    _pubLeft -= size;
+    return _sendOk ? size : 0;
+}
+
+int MqttStream::endPublish() {
+    if (!_pubActive) return 0;
+    _pubActive = false;
+    if (_pubLeft) {
+        lost(MQTT_CONNECTION_LOST);  // the broker is still waiting for payload
+        return 0;
+    }
+    if (!sendPacket()) return 0;
+    if (_pubQos) _inflight[_inflightCount++] = {_packetId, true, false, millis(), NULL, NULL, 0};
+    return 1;
+}
+
+bool MqttStream::subscribe(const char* topic, uint8_t qos) {
+    if (qos > 1 || _pubActive) return false;
+    uint8_t i = 0;
+    while (i < _subscriptionCount && strcmp(_subscriptions[i].topic, topic)) i++;
+    if (i == _subscriptionCount) {
+        if (_subscriptionCount >= MQTT_STREAM_SUBSCRIPTIONS) return false;
+        _subscriptionCount++;
+    } else if (_subscriptions[i].qos == qos && _subscriptions[i].confirmed && connected()) {
+        return true;
+    }
+    _subscriptions[i] = {topic, qos, false, 0};
+    return !connected() || resubscribe();
+}
+
+// one SUBSCRIBE for every topic the broker has not confirmed in this session
+bool MqttStream::resubscribe() {
+    uint32_t remaining = 2;
+    for (uint8_t i = 0; i < _subscriptionCount; i++) {
+        if (!_subscriptions[i].confirmed) remaining += 2 + strlen(_subscriptions[i].topic) + 1;
+    }
+    if (remaining == 2) return true;
+
+    uint16_t id = nextPacketId();
+    stageHeader(MQTT_SUBSCRIBE, remaining);
+    stageByte(id >> 8);
+    stageByte(id & 0xff);
+    for (uint8_t i = 0; i < _subscriptionCount; i++) {
+        Subscription& sub = _subscriptions[i];
+        if (sub.confirmed) continue;
+        stageString(sub.topic);
+        stageByte(sub.qos);
+        sub.packetId = id;
+    }
+    return sendPacket();
+}
+
+bool MqttStream::unsubscribe(const char* topic) {
+    for (uint8_t i = 0; i < _subscriptionCount; i++) {
+        if (strcmp(_subscriptions[i].topic, topic)) continue;
+        _subscriptionCount--;
+        memmove(&_subscriptions[i], &_subscriptions[i + 1], (_subscriptionCount - i) * sizeof(Subscription));
+        break;
+    }
+    if (_pubActive || !connected()) return false;
+    uint16_t id = nextPacketId();
+    stageHeader(MQTT_UNSUBSCRIBE, 2 + 2 + strlen(topic));
+    stageByte(id >> 8);
+    stageByte(id & 0xff);
+    stageString(topic);
+    return sendPacket();
+}
+
+//----------------- Inbound -------------------//
+int MqttStream::readSome(uint8_t* buf, size_t length) {
+    int n = _client.read(buf, length);
+    return n < 0 ? 0 : n;
+}
+
+// consumes what the socket has buffered, a packet split across calls resumes where it stopped
+void MqttStream::receive() {
+    while (_client.available() > 0) {
+        switch (_rxState) {
+            case RX_TYPE:
+                _rxType  = _client.read();
+                _rxLeft  = 0;
+                _rxShift = 0;
+                _rxState = RX_LENGTH;
+                break;
+
+            case RX_LENGTH: {
+                uint8_t b = _client.read();
+                _rxLeft |= (uint32_t)(b & 0x7f) << _rxShift;
+                _rxShift += 7;
+                if (b & 0x80) {
+                    if (_rxShift > 21) {  // more than 4 length bytes
+                        lost(MQTT_CONNECTION_LOST);
+                        return;
+                    }
+                    break;
+                }
+                _lastIn = millis();
+                _rxPos  = 0;
+                if ((_rxType & 0xf0) != MQTT_PUBLISH) {
+                    _rxState = RX_BODY;
+                    if (!_rxLeft) controlPacket();
+                } else if (_rxLeft < 2 || (_rxType & 0x06) == 0x06) {
+                    lost(MQTT_CONNECTION_LOST);
+                    return;
+                } else {
+                    _rxState = RX_TOPICLEN;
+                }
+                break;
+            }
+
+            case RX_BODY: {
+                uint8_t b = _client.read();
+                if (_rxPos < sizeof(_rxHead)) _rxHead[_rxPos++] = b;
+                if (!--_rxLeft) controlPacket();
+                break;
+            }
+
+            case RX_TOPICLEN:
+                _rxTopicLen = (_rxPos ? _rxTopicLen << 8 : 0) | _client.read();
+                _rxLeft--;
+                if (++_rxPos < 2) break;
+                if ((uint32_t)_rxTopicLen + (_rxType & 0x06 ? 2 : 0) > _rxLeft) {
+                    lost(MQTT_CONNECTION_LOST);
+                    return;
+                }
+                _rxPos   = 0;
+                _rxSkip  = _rxTopicLen >= sizeof(_rxTopic);
+                _rxState = RX_TOPIC;
+                if (!_rxTopicLen) topicDone();
+                break;
+
+            case RX_TOPIC: {
+                size_t want = _rxTopicLen - _rxPos;
+                int    n    = _rxSkip ? readSome(_rxBuf, min(want, sizeof(_rxBuf))) : readSome((uint8_t*)_rxTopic + _rxPos, want);
+                if (!n) return;
+                _rxPos += n;
+                _rxLeft -= n;
+                if (_rxPos == _rxTopicLen) topicDone();
+                break;
+            }
+
+            case RX_PACKETID:
+                _rxPacketId = (_rxPos ? _rxPacketId << 8 : 0) | _client.read();
+                _rxLeft--;
+                if (++_rxPos < 2) break;
+                _rxPos    = 0;
+                _rxTotal  = _rxLeft;
+                _rxOffset = 0;
+                _rxState  = RX_PAYLOAD;
+                if (!_rxLeft) deliver();
+                break;
+
+            case RX_PAYLOAD:
+                if (!receivePayload()) return;
+                break;
+        }
+    }
+}
+
+void MqttStream::topicDone() {
+    if (!_rxSkip) _rxTopic[_rxTopicLen] = 0;
+    _rxPos = 0;
+    if (_rxType & 0x06) {
+        _rxState = RX_PACKETID;
+        return;
+    }
+    _rxTotal  = _rxLeft;
+    _rxOffset = 0;
+    _rxState  = RX_PAYLOAD;
+    if (!_rxLeft) deliver();
+}
+
+// payload bytes collect in _rxBuf until it is full or the message ends
+bool MqttStream::receivePayload() {
+    int n = readSome(_rxBuf + _rxPos, min((size_t)_rxLeft, sizeof(_rxBuf) - _rxPos));
+    if (!n) return false;
+    _rxPos += n;
+    _rxLeft -= n;
+    if (!_rxLeft || _rxPos == sizeof(_rxBuf)) deliver();
+    return true;
+}
+
+// a message that fits _rxBuf goes to the message callback, a larger one to the fragment callback piece by piece
+void MqttStream::deliver() {
+    if (!_rxSkip) {
+        if (_rxTotal <= sizeof(_rxBuf)) {
+            if (_callback) _callback(_rxTopic, _rxBuf, _rxPos);
+        } else if (_fragmentCallback) {
+            _fragmentCallback(_rxTopic, _rxBuf, _rxPos, _rxOffset, _rxTotal);
+        }
+    }
+    _rxOffset += _rxPos;
+    _rxPos = 0;
+    if (!_rxLeft) publishDone();
+}
+
+// a PUBACK can not cut into a streamed publish, the broker redelivers the message instead
+void MqttStream::publishDone() {
+    _rxState = RX_TYPE;
+    if (!(_rxType & 0x06) || _state != MQTT_CONNECTED || _pubActive) return;
+    stageByte(MQTT_PUBACK);
+    stageByte(2);
+    stageByte(_rxPacketId >> 8);
+    stageByte(_rxPacketId & 0xff);
+    sendPacket();
+}
+
+void MqttStream::controlPacket() {
+    _rxState = RX_TYPE;
+    switch (_rxType & 0xf0) {
+        case MQTT_CONNACK:
+            _connack        = true;
+            _connackCode    = _rxPos >= 2 ? _rxHead[1] : MQTT_CONNECT_BAD_PROTOCOL;
+            _sessionPresent = _rxPos >= 2 && (_rxHead[0] & 0x01);
+            break;
+        case MQTT_PUBACK:
+            if (_rxPos >= 2) acked(_rxHead[0] << 8 | _rxHead[1]);
+            break;
+        case MQTT_SUBACK:
+            if (_rxPos >= 2) subscribed(_rxHead[0] << 8 | _rxHead[1]);
+            break;
+        case MQTT_PINGRESP:
+            _pingOutstanding = false;
+            break;
+    }
+}
+
+void MqttStream::acked(uint16_t id) {
+    for (uint8_t i = 0; i < _inflightCount; i++) {
+        if (_inflight[i].id == id) {
+            drop(i, true);
+            return;
+        }
+    }
+}
+
+// return codes are not checked, a refused topic would be refused again
+void MqttStream::subscribed(uint16_t id) {
+    for (uint8_t i = 0; i < _subscriptionCount; i++) {
+        if (_subscriptions[i].packetId == id) _subscriptions[i].confirmed = true;
+    }
+}
+
+// keeps the remaining entries in send order
+void MqttStream::drop(uint8_t index, bool acked) {
+    uint16_t id = _inflight[index].id;
+    _inflightCount--;
+    memmove(&_inflight[index], &_inflight[index + 1], (_inflightCount - index) * sizeof(Inflight));
+    if (_ackCallback) _ackCallback(id, acked);
+}
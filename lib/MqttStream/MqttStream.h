@@ -0,0 +1,198 @@
+/*
+    MqttStream, a streaming MQTT 3.1.1 client.
+
+    Outbound packets are written straight to the socket, the topic and payload come from caller
+    memory and only the fixed and variable headers go through a small staging buffer, so payloads
+    are not limited by a packet buffer and are never copied in the client. Inbound PUBLISH
+    payloads up to MQTT_STREAM_BUFFER are delivered whole to the message callback, larger ones are
+    handed to the fragment callback as they arrive.
+
+    loop() only reads what the socket already has and never waits, QoS 1 publishes are pipelined
+    up to the inflight window of unacknowledged packets. With setCleanSession(false) they are kept
+    across reconnects and sent again with DUP set, and publishes made while disconnected are queued
+    in the same window, so the topic and payload must stay valid until the ack callback reports the
+    packet id. Subscriptions are remembered and sent again in one SUBSCRIBE after a reconnect, only
+    when the broker did not keep the session. The API follows PubSubClient:
+
+        WiFiClient net;
+        MqttStream mqtt(net);
+        mqtt.setServer("192.168.0.10", 1883);
+        mqtt.setCallback(onMessage);
+        if (mqtt.connect("id")) mqtt.publish("topic", data, len, false, 1);
+        ...
+        mqtt.loop();
+*/
+#ifndef MQTT_STREAM_H
+#define MQTT_STREAM_H
+
+#include <Arduino.h>
+#include <Client.h>
+#include <functional>
+
+#ifndef MQTT_STREAM_BUFFER
+#define MQTT_STREAM_BUFFER 256  // inbound payloads up to this size are delivered whole, larger ones in fragments of this size
+#endif
+#ifndef MQTT_STREAM_TOPIC
+#define MQTT_STREAM_TOPIC 128  // longest inbound topic, messages with longer topics are skipped
+#endif
+#ifndef MQTT_STREAM_INFLIGHT
+#define MQTT_STREAM_INFLIGHT 8  // QoS 1 publishes awaiting PUBACK, upper bound of setInflightWindow()
+#endif
+#ifndef MQTT_STREAM_SUBSCRIPTIONS
+#define MQTT_STREAM_SUBSCRIPTIONS 8  // topics remembered for resubscribing
+#endif
+#define MQTT_STREAM_STAGE 64  // headers and short writes are gathered here so a small packet leaves in one segment
+
+// state(), same values as PubSubClient
+#define MQTT_CONNECTION_TIMEOUT -4
+#define MQTT_CONNECTION_LOST -3
+#define MQTT_CONNECT_FAILED -2
+#define MQTT_DISCONNECTED -1
+#define MQTT_CONNECTED 0
+#define MQTT_CONNECT_BAD_PROTOCOL 1
+#define MQTT_CONNECT_BAD_CLIENT_ID 2
+#define MQTT_CONNECT_UNAVAILABLE 3
+#define MQTT_CONNECT_BAD_CREDENTIALS 4
+#define MQTT_CONNECT_UNAUTHORIZED 5
+
+class MqttStream : public Print {
+   public:
+    // whole message, payload is valid for the duration of the call
+    typedef std::function<void(char* topic, uint8_t* payload, unsigned int length)> MessageCallback;
+    // one piece of a message larger than MQTT_STREAM_BUFFER, offset + length == total on the last piece
+    typedef std::function<void(const char* topic, const uint8_t* data, size_t length, size_t offset, size_t total)> FragmentCallback;
+    // a QoS 1 publish was acknowledged, or dropped with acked false when it can not be delivered any more
+    typedef std::function<void(uint16_t packetId, bool acked)> AckCallback;
+
+    MqttStream(Client& client);
+
+    MqttStream& setServer(const char* host, uint16_t port);
+    MqttStream& setCallback(MessageCallback callback);
+    MqttStream& setFragmentCallback(FragmentCallback callback);
+    MqttStream& setAckCallback(AckCallback callback);
+    MqttStream& setKeepAlive(uint16_t seconds);
+    MqttStream& setSocketTimeout(uint16_t seconds);  // also the PUBACK timeout, the connection is dropped and the publish retried
+    MqttStream& setCleanSession(bool cleanSession);
+    MqttStream& setInflightWindow(uint8_t window);
+
+    // waits up to the socket timeout for CONNACK
+    bool connect(const char* id, const char* user = NULL, const char* pass = NULL);
+    void disconnect();
+    bool connected();
+    int  state() const { return _state; }
+    bool sessionPresent() const { return _sessionPresent; }  // broker kept our session, from the last CONNACK
+
+    // reads available packets and sends the keepalive ping, false when not connected
+    bool loop();
+
+    // payload is written from caller memory, QoS 1 fails while the inflight window is full and is kept
+    // for a retry until acked, it is queued while disconnected when the session is persistent
+    bool publish(const char* topic, const uint8_t* payload, size_t length, bool retained = false, uint8_t qos = 0);
+    bool publish(const char* topic, const char* payload, bool retained = false);
+
+    // streamed publish of a known length, write() the payload in any pieces then endPublish(),
+    // a QoS 1 streamed publish can not be sent again and is dropped if a reconnect happens before PUBACK
+    bool   beginPublish(const char* topic, size_t length, bool retained = false, uint8_t qos = 0);
+    size_t write(uint8_t b) override;
+    size_t write(const uint8_t* buf, size_t size) override;
+    int    endPublish();
+    using Print::write;
+
+    // the topic is kept by pointer and must stay valid, while disconnected it is sent on the next connect
+    bool subscribe(const char* topic, uint8_t qos = 0);
+    bool unsubscribe(const char* topic);
+
+    uint16_t lastPacketId() const { return _packetId; }  // id of the last QoS 1 publish
+    uint8_t  inflight() const { return _inflightCount; }  // QoS 1 publishes queued or awaiting PUBACK
+
+   private:
+    enum RxState : uint8_t { RX_TYPE, RX_LENGTH, RX_BODY, RX_TOPICLEN, RX_TOPIC, RX_PACKETID, RX_PAYLOAD };
+
+    Client&          _client;
+    const char*      _host = NULL;
+    uint16_t         _port = 1883;
+    MessageCallback  _callback;
+    FragmentCallback _fragmentCallback;
+    AckCallback      _ackCallback;
+    uint16_t         _keepAlive       = 15;  // s
+    uint16_t         _socketTimeout   = 15;  // s
+    int              _state           = MQTT_DISCONNECTED;
+    unsigned long    _lastIn          = 0;
+    unsigned long    _lastOut         = 0;
+    bool             _pingOutstanding = false;
+    bool             _connack         = false;
+    uint8_t          _connackCode     = 0;
+    bool             _sessionPresent  = false;
+    bool             _cleanSession    = true;
+
+    // outbound
+    uint8_t  _stage[MQTT_STREAM_STAGE];
+    size_t   _staged    = 0;
+    bool     _sendOk    = true;
+    uint16_t _nextId    = 0;
+    uint16_t _packetId  = 0;
+    size_t   _pubLeft   = 0;  // payload bytes still owed by a streamed publish
+    bool     _pubActive = false;
+    uint8_t  _pubQos    = 0;
+
+    struct Inflight {
+        uint16_t       id;
+        bool           sent;  // false while queued for the next connection
+        bool           retained;
+        unsigned long  time;  // last sent
+        const char*    topic;  // NULL for a streamed publish, it can not be sent again
+        const uint8_t* payload;
+        size_t         length;
+    };
+    Inflight _inflight[MQTT_STREAM_INFLIGHT];  // oldest first
+    uint8_t  _inflightCount  = 0;
+    uint8_t  _inflightWindow = MQTT_STREAM_INFLIGHT;
+
+    struct Subscription {
+        const char* topic;
+        uint8_t     qos;
+        bool        confirmed;  // SUBACK received in the current session
+        uint16_t    packetId;   // of the SUBSCRIBE that carried it
+    };
+    Subscription _subscriptions[MQTT_STREAM_SUBSCRIPTIONS];
+    uint8_t      _subscriptionCount = 0;
+
+    // inbound
+    RxState  _rxState    = RX_TYPE;
+    uint8_t  _rxType     = 0;
+    uint32_t _rxLeft     = 0;  // bytes left in the current packet
+    uint8_t  _rxShift    = 0;
+    uint16_t _rxPos      = 0;
+    uint16_t _rxTopicLen = 0;
+    uint16_t _rxPacketId = 0;
+    uint32_t _rxTotal    = 0;
+    uint32_t _rxOffset   = 0;
+    bool     _rxSkip     = false;
+    uint8_t  _rxHead[4];
+    char     _rxTopic[MQTT_STREAM_TOPIC];
+    uint8_t  _rxBuf[MQTT_STREAM_BUFFER];
+
+    uint16_t nextPacketId();
+    void     stage(const uint8_t* data, size_t length);
+    void     stageByte(uint8_t b) { stage(&b, 1); }
+    void     stageString(const char* s);
+    void     stageHeader(uint8_t type, uint32_t remaining);
+    bool     sendPacket();
+    bool     sendPublish(Inflight& msg);
+    bool     resend();
+    bool     resubscribe();
+
+    int  readSome(uint8_t* buf, size_t length);
+    void receive();
+    bool receivePayload();
+    void topicDone();
+    void deliver();
+    void controlPacket();
+    void publishDone();
+    void acked(uint16_t id);
+    void subscribed(uint16_t id);
+    void drop(uint8_t index, bool acked);
+    void lost(int state);
+};
+
+#endif
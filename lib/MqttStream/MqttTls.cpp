@@ -0,0 +1,390 @@
+#include "MqttTls.h"
+#include <WiFi.h>
+#include <lwip/sockets.h>
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/version.h>
+#include <memory>
+
+// in front of the saved session in the cache buffer
+struct SessionHeader {
+    uint32_t peer;
+    uint16_t length;  // 0 when empty
+};
+
+static uint32_t peerHash(const char* host, uint16_t port) {
+    uint32_t hash = 2166136261u;  // FNV-1a
+    for (; *host; host++) hash = (hash ^ (uint8_t)*host) * 16777619u;
+    hash = (hash ^ (port & 0xff)) * 16777619u;
+    return (hash ^ (port >> 8)) * 16777619u;
+}
+
+static bool handshakeOver(mbedtls_ssl_context* ssl) {
+#if MBEDTLS_VERSION_NUMBER >= 0x03020000
+    return mbedtls_ssl_is_handshake_over(ssl);
+#else
+    return ssl->state == MBEDTLS_SSL_HANDSHAKE_OVER;
+#endif
+}
+
+// whole file into a nul terminated heap buffer, as mbedtls wants PEM
+static std::unique_ptr<char[]> readFile(fs::FS& fs, const char* path) {
+    File file = fs.open(path, "r");
+    if (!file) return nullptr;
+    size_t                  size = file.size();
+    std::unique_ptr<char[]> buf(new char[size + 1]);
+    buf[file.readBytes(buf.get(), size)] = 0;
+    file.close();
+    return buf;
+}
+
+MqttTls::MqttTls() {
+    mbedtls_ssl_init(&_ssl);
+    mbedtls_ssl_config_init(&_conf);
+    mbedtls_entropy_init(&_entropy);
+    mbedtls_ctr_drbg_init(&_drbg);
+    mbedtls_x509_crt_init(&_ca);
+    mbedtls_x509_crt_init(&_cert);
+    mbedtls_pk_init(&_key);
+}
+
+MqttTls::~MqttTls() {
+    stop();
+    mbedtls_ssl_free(&_ssl);
+    mbedtls_ssl_config_free(&_conf);
+    mbedtls_ctr_drbg_free(&_drbg);
+    mbedtls_entropy_free(&_entropy);
+    mbedtls_x509_crt_free(&_ca);
+    mbedtls_x509_crt_free(&_cert);
+    mbedtls_pk_free(&_key);
+}
+
+//----------------- Credentials ---------------//
+bool MqttTls::setCACert(const char* pem) {
+    mbedtls_x509_crt_free(&_ca);
+    mbedtls_x509_crt_init(&_ca);
+    _lastError = mbedtls_x509_crt_parse(&_ca, (const unsigned char*)pem, strlen(pem) + 1);
+    _hasCA     = _lastError == 0;
+    return _hasCA;
+}
+
+bool MqttTls::setCertificate(const char* certPem, const char* keyPem) {
+    mbedtls_x509_crt_free(&_cert);
+    mbedtls_x509_crt_init(&_cert);
+    mbedtls_pk_free(&_key);
+    mbedtls_pk_init(&_key);
+    _hasCert = false;
+    if (!configure()) return false;
+
+    _lastError = mbedtls_x509_crt_parse(&_cert, (const unsigned char*)certPem, strlen(certPem) + 1);
+    if (_lastError) return false;
+#if MBEDTLS_VERSION_MAJOR >= 3
+    _lastError = mbedtls_pk_parse_key(&_key, (const unsigned char*)keyPem, strlen(keyPem) + 1, NULL, 0,
+                                      mbedtls_ctr_drbg_random, &_drbg);
+#else
+    _lastError = mbedtls_pk_parse_key(&_key, (const unsigned char*)keyPem, strlen(keyPem) + 1, NULL, 0);
+#endif
+    _hasCert = _lastError == 0;
+    return _hasCert;
+}
+
+// the PEM text is only held while it is parsed
+bool MqttTls::loadCredentials(fs::FS& fs, const char* caPath, const char* certPath, const char* keyPath) {
+    std::unique_ptr<char[]> ca = readFile(fs, caPath);
+    if (!ca || !setCACert(ca.get())) return false;
+    ca.reset();
+    if (!certPath || !keyPath) return true;
+
+    std::unique_ptr<char[]> cert = readFile(fs, certPath);
+    std::unique_ptr<char[]> key  = readFile(fs, keyPath);
+    return cert && key && setCertificate(cert.get(), key.get());
+}
+
+// the broker certificate is not checked, for testing only
+void MqttTls::setInsecure() {
+    _insecure = true;
+}
+
+void MqttTls::setSessionCache(uint8_t* buf, size_t size) {
+    _cache     = size > sizeof(SessionHeader) ? buf : NULL;
+    _cacheSize = size;
+}
+
+void MqttTls::clearSession() {
+    if (!_cache) return;
+    SessionHeader header = {0, 0};
+    memcpy(_cache, &header, sizeof(header));
+}
+
+//----------------- Connection ----------------//
+// done once, the random generator is seeded and the config is kept for every connect
+bool MqttTls::configure() {
+    if (_configured) return true;
+    static const char personal[] = "MqttTls";
+    int err = mbedtls_ctr_drbg_seed(&_drbg, mbedtls_entropy_func, &_entropy, (const unsigned char*)personal,
+                                    sizeof(personal) - 1);
+    if (!err) {
+        err = mbedtls_ssl_config_defaults(&_conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                          MBEDTLS_SSL_PRESET_DEFAULT);
+    }
+    if (err) {
+        _lastError = err;
+        return false;
+    }
+    mbedtls_ssl_conf_rng(&_conf, mbedtls_ctr_drbg_random, &_drbg);
+    mbedtls_ssl_conf_verify(&_conf, verifyCallback, this);
+#ifdef MBEDTLS_SSL_SESSION_TICKETS
+    mbedtls_ssl_conf_session_tickets(&_conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+    _configured = true;
+    return true;
+}
+
+int MqttTls::connect(const char* host, uint16_t port) {
+    unsigned long start = millis();
+    IPAddress     ip;
+    if (!WiFi.hostByName(host, ip)) return 0;
+    _peer = peerHash(host, port);
+    return tcpConnect(ip, port, start) && handshake(host, start);
+}
+
+int MqttTls::connect(IPAddress ip, uint16_t port) {
+    unsigned long start = millis();
+    _peer               = peerHash(ip.toString().c_str(), port);
+    return tcpConnect(ip, port, start) && handshake(NULL, start);
+}
+
+int MqttTls::connect(const char* host, uint16_t port, int32_t timeout) {
+    _timeout = timeout;
+    return connect(host, port);
+}
+
+int MqttTls::connect(IPAddress ip, uint16_t port, int32_t timeout) {
+    _timeout = timeout;
+    return connect(ip, port);
+}
+
+bool MqttTls::tcpConnect(IPAddress ip, uint16_t port, unsigned long start) {
+    stop();
+    _fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (_fd < 0) return fail(MBEDTLS_ERR_NET_SOCKET_FAILED);
+    fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL, 0) | O_NONBLOCK);
+
+    struct sockaddr_in addr = {};
+    addr.sin_family         = AF_INET;
+    addr.sin_addr.s_addr    = (uint32_t)ip;
+    addr.sin_port           = htons(port);
+    if (::connect(_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 && errno != EINPROGRESS) {
+        return fail(MBEDTLS_ERR_NET_CONNECT_FAILED);
+    }
+    if (!waitSocket(true, start)) return fail(MBEDTLS_ERR_NET_CONNECT_FAILED);
+
+    int       err = 0;
+    socklen_t len = sizeof(err);
+    getsockopt(_fd, SOL_SOCKET, SO_ERROR, &err, &len);
+    return err ? fail(MBEDTLS_ERR_NET_CONNECT_FAILED) : true;
+}
+
+// the context from the previous connect is reset rather than set up again, so its record buffers are reused
+bool MqttTls::handshake(const char* host, unsigned long start) {
+    uint32_t heapBefore = ESP.getFreeHeap();
+    uint32_t heapLow    = heapBefore;
+
+    int err = 0;
+    if (!configure()) return fail(_lastError);
+    if (!_hasCA && !_insecure) return fail(MBEDTLS_ERR_X509_CERT_VERIFY_FAILED);
+    // optional still runs the verify callback, which tells a full handshake from a resumed one
+    mbedtls_ssl_conf_authmode(&_conf, _insecure ? MBEDTLS_SSL_VERIFY_OPTIONAL : MBEDTLS_SSL_VERIFY_REQUIRED);
+    mbedtls_ssl_conf_ca_chain(&_conf, _hasCA ? &_ca : NULL, NULL);
+    if (_hasCert && !_ownCert) {
+        err = mbedtls_ssl_conf_own_cert(&_conf, &_cert, &_key);  // adds to a list, so only once
+        if (err) return fail(err);
+        _ownCert = true;
+    }
+
+    err = _sslReady ? mbedtls_ssl_session_reset(&_ssl) : mbedtls_ssl_setup(&_ssl, &_conf);
+    if (err) return fail(err);
+    _sslReady = true;
+    if (host && (err = mbedtls_ssl_set_hostname(&_ssl, host))) return fail(err);
+    mbedtls_ssl_set_bio(&_ssl, this, sendCallback, recvCallback, NULL);
+
+    bool offered = loadSession();
+    _verified    = false;
+    while (!handshakeOver(&_ssl)) {
+        err     = mbedtls_ssl_handshake_step(&_ssl);
+        heapLow = min(heapLow, ESP.getFreeHeap());  // between steps only, peaks inside a step are missed
+        if (err == MBEDTLS_ERR_SSL_WANT_READ || err == MBEDTLS_ERR_SSL_WANT_WRITE) {
+            if (!waitSocket(err == MBEDTLS_ERR_SSL_WANT_WRITE, start)) return fail(MBEDTLS_ERR_SSL_TIMEOUT);
+            continue;
+        }
+        if (err) {
+            if (offered) clearSession();  // a session the broker chokes on is not offered again
+            return fail(err);
+        }
+    }
+
+    _connected     = true;
+    _handshakeTime = millis() - start;
+    _handshakeHeap = heapBefore - heapLow;
+    _resumed       = offered && !_verified;
+    saveSession();
+    return true;
+}
+
+// offers the cached session if it was issued by this broker
+bool MqttTls::loadSession() {
+    if (!_cache) return false;
+    SessionHeader header;
+    memcpy(&header, _cache, sizeof(header));
+    if (!header.length || header.peer != _peer || header.length > _cacheSize - sizeof(header)) return false;
+
+    mbedtls_ssl_session session;
+    mbedtls_ssl_session_init(&session);
+    bool ok = mbedtls_ssl_session_load(&session, _cache + sizeof(header), header.length) == 0 &&
+              mbedtls_ssl_set_session(&_ssl, &session) == 0;
+    mbedtls_ssl_session_free(&session);
+    if (!ok) clearSession();
+    return ok;
+}
+
+// after every handshake, the broker may have issued a new ticket
+void MqttTls::saveSession() {
+    if (!_cache) return;
+    clearSession();
+
+    mbedtls_ssl_session session;
+    mbedtls_ssl_session_init(&session);
+    size_t length = 0;
+    if (mbedtls_ssl_get_session(&_ssl, &session) == 0 &&
+        mbedtls_ssl_session_save(&session, _cache + sizeof(SessionHeader), _cacheSize - sizeof(SessionHeader),
+                                 &length) == 0 &&
+        length <= 0xffff) {
+        SessionHeader header = {_peer, (uint16_t)length};
+        memcpy(_cache, &header, sizeof(header));
+    }
+    mbedtls_ssl_session_free(&session);
+}
+
+bool MqttTls::waitSocket(bool write, unsigned long start) {
+    unsigned long elapsed = millis() - start;
+    if (elapsed >= _timeout) return false;
+    unsigned long  left = _timeout - elapsed;
+    fd_set         set;
+    struct timeval tv = {(time_t)(left / 1000), (suseconds_t)(left % 1000 * 1000)};
+    FD_ZERO(&set);
+    FD_SET(_fd, &set);
+    return select(_fd + 1, write ? NULL : &set, write ? &set : NULL, NULL, &tv) > 0;
+}
+
+int MqttTls::fail(int err) {
+    _lastError = err;
+    stop();
+    return 0;
+}
+
+void MqttTls::stop() {
+    if (_connected) mbedtls_ssl_close_notify(&_ssl);  // best effort, the socket does not block
+    if (_fd >= 0) close(_fd);
+    _fd        = -1;
+    _connected = false;
+    _peeked    = -1;
+}
+
+uint8_t MqttTls::connected() {
+    if (!_connected) return 0;
+    if (_peeked >= 0 || mbedtls_ssl_get_bytes_avail(&_ssl)) return 1;
+    char c;
+    int  n = recv(_fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (n > 0 || (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))) return 1;
+    fail(n == 0 ? MBEDTLS_ERR_SSL_CONN_EOF : MBEDTLS_ERR_NET_RECV_FAILED);
+    return 0;
+}
+
+int MqttTls::setNoDelay(bool nodelay) {
+    int flag = nodelay;
+    return setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+}
+
+//----------------- Data ----------------------//
+size_t MqttTls::write(uint8_t b) {
+    return write(&b, 1);
+}
+
+size_t MqttTls::write(const uint8_t* buf, size_t size) {
+    if (!_connected) return 0;
+    unsigned long start = millis();
+    size_t        sent  = 0;
+    while (sent < size) {
+        int n = mbedtls_ssl_write(&_ssl, buf + sent, size - sent);
+        if (n > 0) {
+            sent += n;
+        } else if ((n == MBEDTLS_ERR_SSL_WANT_WRITE || n == MBEDTLS_ERR_SSL_WANT_READ) &&
+                   waitSocket(n == MBEDTLS_ERR_SSL_WANT_WRITE, start)) {
+            continue;
+        } else {
+            fail(n);
+            break;
+        }
+    }
+    return sent;
+}
+
+// decrypts the next record when the socket has one, never waits
+int MqttTls::available() {
+    if (!_connected) return 0;
+    int n = mbedtls_ssl_get_bytes_avail(&_ssl) + (_peeked >= 0);
+    if (n) return n;
+    int err = mbedtls_ssl_read(&_ssl, NULL, 0);
+    if (err < 0 && err != MBEDTLS_ERR_SSL_WANT_READ && err != MBEDTLS_ERR_SSL_WANT_WRITE) {
+        fail(err);
+        return 0;
+    }
+    return mbedtls_ssl_get_bytes_avail(&_ssl);
+}
+
+int MqttTls::read(uint8_t* buf, size_t size) {
+    if (!_connected || !size) return -1;
+    int got = 0;
+    if (_peeked >= 0) {
+        buf[got++] = _peeked;
+        _peeked    = -1;
+        if (size == 1) return 1;
+    }
+    int n = mbedtls_ssl_read(&_ssl, buf + got, size - got);
+    if (n > 0) return got + n;
+    if (n == 0 || (n != MBEDTLS_ERR_SSL_WANT_READ && n != MBEDTLS_ERR_SSL_WANT_WRITE)) fail(n);
+    return got ? got : -1;
+}
+
+int MqttTls::read() {
+    uint8_t b;
+    return read(&b, 1) == 1 ? b : -1;
+}
+
+int MqttTls::peek() {
+    if (_peeked < 0) {
+        uint8_t b;
+        if (read(&b, 1) == 1) _peeked = b;
+    }
+    return _peeked;
+}
+
+//----------------- Callbacks -----------------//
+int MqttTls::sendCallback(void* ctx, const unsigned char* buf, size_t len) {
+    int n = send(((MqttTls*)ctx)->_fd, buf, len, 0);
+    if (n >= 0) return n;
+    return errno == EAGAIN || errno == EWOULDBLOCK ? MBEDTLS_ERR_SSL_WANT_WRITE : MBEDTLS_ERR_NET_SEND_FAILED;
+}
+
+int MqttTls::recvCallback(void* ctx, unsigned char* buf, size_t len) {
+    int n = recv(((MqttTls*)ctx)->_fd, buf, len, 0);
+    if (n >= 0) return n;
+    return errno == EAGAIN || errno == EWOULDBLOCK ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_RECV_FAILED;
+}
+
+// only called during a full handshake, a resumed session skips the certificate exchange
+int MqttTls::verifyCallback(void* ctx, mbedtls_x509_crt* crt, int depth, uint32_t* flags) {
+    MqttTls* tls   = (MqttTls*)ctx;
+    tls->_verified = true;
+    if (tls->_insecure) *flags = 0;
+    return 0;
+}
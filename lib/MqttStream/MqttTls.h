@@ -0,0 +1,118 @@
+/*
+    MqttTls, a TLS client for MqttStream built on mbedtls.
+
+    WiFiClientSecure parses the certificates and builds a new TLS context on every connect, and
+    always runs a full handshake. MqttTls parses the CA and client certificate once and keeps the
+    TLS context between connects, and saves the negotiated session (ticket or session id) into a
+    caller buffer after every handshake. When that buffer lives in RTC memory, the next connect,
+    also after a deep sleep, offers the session and the broker can resume it with an abbreviated
+    handshake instead of a certificate exchange and key agreement:
+
+        RTC_DATA_ATTR uint8_t tlsSession[MQTT_TLS_SESSION_CACHE];
+
+        MqttTls    net;
+        MqttStream mqtt(net);
+        net.loadCredentials(SPIFFS, "/ca.pem", "/client.crt", "/client.key");
+        net.setSessionCache(tlsSession, sizeof(tlsSession));
+
+    handshakeTime(), handshakeHeap() and resumed() describe the last connect.
+*/
+#ifndef MQTT_TLS_H
+#define MQTT_TLS_H
+
+#include <Arduino.h>
+#include <Client.h>
+#include <FS.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/x509_crt.h>
+#include <mbedtls/pk.h>
+
+#ifndef MQTT_TLS_SESSION_CACHE
+#define MQTT_TLS_SESSION_CACHE 2048  // bytes for a saved session, the broker certificate is kept in it
+#endif
+#ifndef MQTT_TLS_TIMEOUT
+#define MQTT_TLS_TIMEOUT 10000  // ms, tcp connect plus handshake
+#endif
+
+class MqttTls : public Client {
+   public:
+    MqttTls();
+    ~MqttTls();
+
+    // PEM, parsed once and kept for every connect, without a CA the connect fails unless setInsecure()
+    bool setCACert(const char* pem);
+    bool setCertificate(const char* certPem, const char* keyPem);
+    bool loadCredentials(fs::FS& fs, const char* caPath, const char* certPath = NULL, const char* keyPath = NULL);
+    void setInsecure();
+    void setSessionCache(uint8_t* buf, size_t size);
+    void clearSession();
+
+    int     connect(IPAddress ip, uint16_t port) override;
+    int     connect(const char* host, uint16_t port) override;
+    int     connect(IPAddress ip, uint16_t port, int32_t timeout);  // ms, for tcp connect plus handshake
+    int     connect(const char* host, uint16_t port, int32_t timeout);
+    size_t  write(uint8_t b) override;
+    size_t  write(const uint8_t* buf, size_t size) override;
+    int     available() override;
+    int     read() override;
+    int     read(uint8_t* buf, size_t size) override;
+    int     peek() override;
+    void    flush() override {}
+    void    stop() override;
+    uint8_t connected() override;
+    operator bool() override { return connected(); }
+
+    int fd() const { return _fd; }
+    int setNoDelay(bool nodelay);
+
+    uint32_t handshakeTime() const { return _handshakeTime; }  // ms, tcp connect to handshake done
+    uint32_t handshakeHeap() const { return _handshakeHeap; }  // bytes, approximate, free heap before minus the lowest seen between handshake steps
+    bool     resumed() const { return _resumed; }
+    int      lastError() const { return _lastError; }  // mbedtls error code of the last failure
+
+   private:
+    mbedtls_ssl_context      _ssl;
+    mbedtls_ssl_config       _conf;
+    mbedtls_entropy_context  _entropy;
+    mbedtls_ctr_drbg_context _drbg;
+    mbedtls_x509_crt         _ca;
+    mbedtls_x509_crt         _cert;
+    mbedtls_pk_context       _key;
+
+    bool     _configured = false;
+    bool     _sslReady   = false;  // _ssl set up, reset instead of set up again on the next connect
+    bool     _hasCA      = false;
+    bool     _hasCert    = false;
+    bool     _ownCert    = false;  // client certificate handed to _conf
+    bool     _insecure   = false;
+    int      _fd         = -1;
+    bool     _connected  = false;
+    int      _peeked     = -1;
+    int      _lastError  = 0;
+    uint32_t _timeout    = MQTT_TLS_TIMEOUT;
+    uint32_t _handshakeTime = 0;
+    uint32_t _handshakeHeap = 0;
+    bool     _resumed       = false;
+    bool     _verified      = false;  // certificate chain checked, so the handshake was a full one
+
+    // saved session, a header then the mbedtls_ssl_session_save() output
+    uint8_t* _cache     = NULL;
+    size_t   _cacheSize = 0;
+    uint32_t _peer      = 0;  // hash of host and port, a session is only offered back to the broker that issued it
+
+    bool configure();
+    bool tcpConnect(IPAddress ip, uint16_t port, unsigned long start);
+    bool handshake(const char* host, unsigned long start);
+    bool loadSession();
+    void saveSession();
+    bool waitSocket(bool write, unsigned long start);
+    int  fail(int err);
+
+    static int sendCallback(void* ctx, const unsigned char* buf, size_t len);
+    static int recvCallback(void* ctx, unsigned char* buf, size_t len);
+    static int verifyCallback(void* ctx, mbedtls_x509_crt* crt, int depth, uint32_t* flags);
+};
+
+#endif
@@ -0,0 +1,196 @@
+'use strict';
+
+// MQTT 3.1.1 broker stand-in for exercising MqttStream without a real broker
+// usage: node broker.js [port=1883] [--drop-puback=N] [--drop-after=N] [--no-session] [--tls=key.pem,cert.pem]
+// --drop-puback=N  the first N connections get no PUBACK for their QoS 1 publishes, like a stuck broker,
+//                  the client times out, reconnects and must send them again with DUP set
+// --drop-after=N   close each connection after N publishes, like a broker failover
+// --no-session     forget every session on disconnect, like failing over to a broker without shared state
+// --tls=key,cert   serve TLS 1.2 with session tickets and ids, each connection logs a full or resumed handshake
+// sessions of clients connecting with clean session 0 are kept, subscriptions included, and
+// CONNACK reports session present for them; QoS 1 deliveries to subscribers are sent as QoS 1
+
+const fs = require('fs');
+const net = require('net');
+const tls = require('tls');
+
+const args = process.argv.slice(2);
+const opt = function (name, def) {
+  const a = args.find(function (x) { return x.indexOf('--' + name + '=') === 0; });
+  return a ? parseInt(a.split('=')[1], 10) : def;
+};
+const port = parseInt(args.find(function (x) { return /^\d+$/.test(x); }) || '1883', 10);
+const dropPuback = opt('drop-puback', 0);
+const dropAfter = opt('drop-after', 0);
+const keepSessions = args.indexOf('--no-session') < 0;
+const tlsFiles = (args.find(function (x) { return x.indexOf('--tls=') === 0; }) || '').slice(6).split(',');
+
+const sessions = {}; // client id -> { subs: {filter: qos}, sock }
+let connections = 0;
+let nextId = 1;
+
+function log() {
+  console.log.apply(console, [new Date().toISOString().slice(11, 23)].concat([].slice.call(arguments)));
+}
+
+function encodeLength(n) {
+  const out = [];
+  do {
+    let b = n & 0x7f;
+    n >>= 7;
+    if (n) b |= 0x80;
+    out.push(b);
+  } while (n);
+  return out;
+}
+
+function packet(type, body) {
+  return Buffer.concat([Buffer.from([type].concat(encodeLength(body.length))), body]);
+}
+
+function str(s) {
+  const b = Buffer.from(s);
+  return Buffer.concat([Buffer.from([b.length >> 8, b.length & 0xff]), b]);
+}
+
+function matches(filter, topic) {
+  const f = filter.split('/');
+  const t = topic.split('/');
+  for (let i = 0; i < f.length; i++) {
+    if (f[i] === '#') return true;
+    if (i >= t.length || (f[i] !== '+' && f[i] !== t[i])) return false;
+  }
+  return f.length === t.length;
+}
+
+function route(topic, payload, retain) {
+  Object.keys(sessions).forEach(function (id) {
+    const s = sessions[id];
+    if (!s.sock) return;
+    Object.keys(s.subs).forEach(function (filter) {
+      if (!matches(filter, topic)) return;
+      const qos = s.subs[filter];
+      const head = qos ? Buffer.concat([str(topic), Buffer.from([nextId >> 8, nextId & 0xff])]) : str(topic);
+      nextId = (nextId % 0xffff) + 1;
+      s.sock.write(packet(0x30 | (qos << 1) | (retain ? 1 : 0), Buffer.concat([head, payload])));
+    });
+  });
+}
+
+function serve(sock) {
+  const conn = ++connections;
+  if (sock.encrypted) log('#' + conn, 'TLS', sock.getProtocol(), sock.isSessionReused() ? 'resumed' : 'full handshake');
+  let buf = Buffer.alloc(0);
+  let session = null;
+  let clientId = '?';
+  let publishes = 0;
+
+  function handle(type, flags, body) {
+    switch (type) {
+      case 1: { // CONNECT
+        let off = 2 + body.readUInt16BE(0) + 1;
+        const cflags = body[off];
+        const keepalive = body.readUInt16BE(off + 1);
+        off += 3;
+        clientId = body.toString('utf8', off + 2, off + 2 + body.readUInt16BE(off));
+        const clean = !!(cflags & 0x02);
+        const present = !clean && !!sessions[clientId];
+        if (clean || !sessions[clientId]) sessions[clientId] = { subs: {} };
+        if (sessions[clientId].sock) sessions[clientId].sock.destroy();
+        session = sessions[clientId];
+        session.sock = sock;
+        session.clean = clean;
+        log('#' + conn, clientId, 'CONNECT clean=' + (clean ? 1 : 0), 'keepalive=' + keepalive, 'present=' + (present ? 1 : 0));
+        sock.write(packet(0x20, Buffer.from([present ? 1 : 0, 0])));
+        break;
+      }
+      case 3: { // PUBLISH
+        const qos = (flags >> 1) & 3;
+        const tlen = body.readUInt16BE(0);
+        const topic = body.toString('utf8', 2, 2 + tlen);
+        let off = 2 + tlen;
+        let id = 0;
+        if (qos) {
+          id = body.readUInt16BE(off);
+          off += 2;
+        }
+        const payload = body.slice(off);
+        const drop = qos === 1 && conn <= dropPuback;
+        log('#' + conn, clientId, 'PUBLISH', topic, 'qos=' + qos, 'id=' + id, (flags & 0x08) ? 'DUP' : '', payload.length + ' bytes', drop ? '(no puback)' : '');
+        if (qos === 1 && !drop) sock.write(packet(0x40, Buffer.from([id >> 8, id & 0xff])));
+        route(topic, payload, flags & 1);
+        if (dropAfter && ++publishes >= dropAfter) {
+          log('#' + conn, clientId, 'closing after', publishes, 'publishes');
+          sock.destroy();
+        }
+        break;
+      }
+      case 4: // PUBACK
+        break;
+      case 8: { // SUBSCRIBE
+        const id = body.readUInt16BE(0);
+        const granted = [];
+        const filters = [];
+        for (let off = 2; off < body.length;) {
+          const len = body.readUInt16BE(off);
+          const filter = body.toString('utf8', off + 2, off + 2 + len);
+          const qos = Math.min(body[off + 2 + len], 1);
+          session.subs[filter] = qos;
+          granted.push(qos);
+          filters.push(filter + ':' + qos);
+          off += 3 + len;
+        }
+        log('#' + conn, clientId, 'SUBSCRIBE id=' + id, filters.join(' '));
+        sock.write(packet(0x90, Buffer.concat([Buffer.from([id >> 8, id & 0xff]), Buffer.from(granted)])));
+        break;
+      }
+      case 10: { // UNSUBSCRIBE
+        const id = body.readUInt16BE(0);
+        sock.write(packet(0xb0, Buffer.from([id >> 8, id & 0xff])));
+        break;
+      }
+      case 12: // PINGREQ
+        sock.write(Buffer.from([0xd0, 0]));
+        break;
+      case 14: // DISCONNECT
+        log('#' + conn, clientId, 'DISCONNECT');
+        sock.end();
+        break;
+      default:
+        log('#' + conn, clientId, 'packet type', type);
+    }
+  }
+
+  sock.on('data', function (data) {
+    buf = Buffer.concat([buf, data]);
+    for (;;) {
+      let len = 0;
+      let mul = 1;
+      let i = 1;
+      for (; i < buf.length && i < 5; i++) {
+        len += (buf[i] & 0x7f) * mul;
+        mul *= 128;
+        if (!(buf[i] & 0x80)) break;
+      }
+      if (i >= buf.length || buf.length < i + 1 + len) return;
+      const body = buf.slice(i + 1, i + 1 + len);
+      handle(buf[0] >> 4, buf[0] & 0x0f, body);
+      buf = buf.slice(i + 1 + len);
+    }
+  });
+  sock.on('error', function () {});
+  sock.on('close', function () {
+    if (session && session.sock === sock) {
+      session.sock = null;
+      if (session.clean || !keepSessions) delete sessions[clientId];
+    }
+    log('#' + conn, clientId, 'closed');
+  });
+}
+
+const server = tlsFiles[0]
+  ? tls.createServer({ key: fs.readFileSync(tlsFiles[0]), cert: fs.readFileSync(tlsFiles[1]), maxVersion: 'TLSv1.2' }, serve)
+  : net.createServer(serve);
+server.listen(port, function () {
+  log('broker stand-in on port', port, tlsFiles[0] ? 'with TLS' : '', dropPuback ? 'dropping PUBACK on the first ' + dropPuback + ' connections' : '');
+});
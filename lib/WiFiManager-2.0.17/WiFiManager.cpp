@@ -177,6 +177,7 @@ bool WiFiManager::addParameter(WiFiManagerParameter *p) {
 
   _params[_paramsCount] = p;
   _paramsCount++;
+  _rootCache = String(); // param menu item shows with the first param
   
   #ifdef WM_DEBUG_LEVEL
   DEBUG_WM(WM_DEBUG_VERBOSE,F("Added Parameter:"),p->getID());
@@ -200,6 +201,170 @@ int WiFiManager::getParametersCount() {
   return _paramsCount;
 }
 
+#ifdef WM_FASTDNS
+/**
+ * --------------------------------------------------------------------------------
+ *  WiFiManagerDNS
+ * --------------------------------------------------------------------------------
+**/
+
+WiFiManagerDNS::~WiFiManagerDNS(){
+  stop();
+}
+
+/**
+ * open the dns socket and prebuild the A answer
+ * @param  uint16_t  port
+ * @param  IPAddress ip   address returned for every name
+ * @return bool
+ */
+bool WiFiManagerDNS::start(uint16_t port, const IPAddress &ip){
+  stop();
+  // name ptr to offset 12, type A, class IN, ttl 60, rdlength 4, ip
+  const uint8_t rr[12] = { 0xC0, 0x0C, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00, 0x3C, 0x00, 0x04 };
+  memcpy(_answer, rr, sizeof(rr));
+  for(uint8_t i = 0; i < 4; i++) _answer[12 + i] = ip[i];
+  memset(_clients, 0, sizeof(_clients));
+
+  #ifdef ESP32
+  _sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if(_sock < 0) return false;
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_port        = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if(bind(_sock, (struct sockaddr*)&addr, sizeof(addr)) < 0){
+    stop();
+    return false;
+  }
+  fcntl(_sock, F_SETFL, O_NONBLOCK);
+  return true;
+  #else
+  _started = _udp.begin(port);
+  return _started;
+  #endif
+}
+
+void WiFiManagerDNS::stop(){
+  #ifdef ESP32
+  if(_sock >= 0) close(_sock);
+  _sock = -1;
+  #else
+  if(_started) _udp.stop();
+  _started = false;
+  #endif
+}
+
+/**
+ * answer pending queries, bounded by WM_DNS_BUDGET so a flood cannot starve the http server
+ * @return uint8_t queries answered
+ */
+uint8_t WiFiManagerDNS::processNextRequest(){
+  uint8_t answered = 0;
+  for(uint8_t i = 0; i < WM_DNS_BUDGET; i++){
+    #ifdef ESP32
+    if(_sock < 0) break;
+    struct sockaddr_in from;
+    socklen_t fromlen = sizeof(from);
+    int len = recvfrom(_sock, _buf, sizeof(_buf), MSG_DONTWAIT, (struct sockaddr*)&from, &fromlen);
+    if(len <= 0) break;
+    uint32_t ip = from.sin_addr.s_addr;
+    #else
+    if(!_started) break;
+    int len = _udp.parsePacket();
+    if(len <= 0) break;
+    if((size_t)len > sizeof(_buf)){
+      _udp.flush();
+      _dropped++;
+      continue;
+    }
+    _udp.read(_buf, len);
+    uint32_t ip = (uint32_t)_udp.remoteIP();
+    #endif
+
+    _queries++;
+    size_t rlen = allow(ip) ? answer(len) : 0;
+    if(!rlen){
+      _dropped++;
+      continue;
+    }
+
+    #ifdef ESP32
+    sendto(_sock, _buf, rlen, 0, (struct sockaddr*)&from, fromlen);
+    #else
+    _udp.beginPacket(_udp.remoteIP(), _udp.remotePort());
+    _udp.write(_buf, rlen);
+    _udp.endPacket();
+    #endif
+    answered++;
+  }
+  return answered;
+}
+
+/**
+ * per client fixed window rate limit, least recently seen client is evicted when the table is full
+ * @param  uint32_t ip
+ * @return bool     false if over WM_DNS_RATE for the current second
+ */
+bool WiFiManagerDNS::allow(uint32_t ip){
+  uint32_t now = millis() / 1000;
+  uint8_t slot = 0;
+  for(uint8_t i = 0; i < WM_DNS_CLIENTS; i++){
+    if(_clients[i].ip == ip){
+      slot = i;
+      break;
+    }
+    if(_clients[i].window < _clients[slot].window) slot = i;
+  }
+  if(_clients[slot].ip != ip || _clients[slot].window != now){
+    _clients[slot].ip     = ip;
+    _clients[slot].window = now;
+    _clients[slot].count  = 0;
+  }
+  return ++_clients[slot].count <= WM_DNS_RATE;
+}
+
+/**
+ * turn the query in _buf into a response in place
+ * @param  size_t len query length
+ * @return size_t     response length, 0 to drop
+ */
+size_t WiFiManagerDNS::answer(size_t len){
+  if(len < 12 || (_buf[2] & 0x80)) return 0; // short or not a query
+
+  uint8_t  opcode  = (_buf[2] >> 3) & 0x0F;
+  uint16_t qdcount = (_buf[4] << 8) | _buf[5];
+  _buf[2] = 0x84 | (_buf[2] & 0x01); // response, authoritative, keep recursion desired
+  memset(_buf + 6, 0, 6);            // no answers, authority or additional (drops edns)
+
+  if(opcode != 0 || qdcount != 1){
+    _buf[3] = 0x04; // not implemented
+    memset(_buf + 4, 0, 2);
+    return 12;
+  }
+  _buf[3] = 0x00; // noerror
+
+  // skip the question name, uncompressed labels only
+  size_t p = 12;
+  while(p < len && _buf[p]){
+    if(_buf[p] & 0xC0) return 0;
+    p += _buf[p] + 1;
+  }
+  if(p + 5 > len) return 0;
+  uint16_t qtype = (_buf[p + 1] << 8) | _buf[p + 2];
+  p += 5; // null label, qtype, qclass
+
+  if(qtype == 1 || qtype == 255){ // A or ANY
+    if(p + sizeof(_answer) > sizeof(_buf)) return 0;
+    memcpy(_buf + p, _answer, sizeof(_answer));
+    _buf[7] = 1;
+    p += sizeof(_answer);
+  }
+  return p;
+}
+#endif
+
 /**
  * --------------------------------------------------------------------------------
  *  WiFiManager 
@@ -216,6 +381,13 @@ WiFiManager::WiFiManager() {
 }
 
 void WiFiManager::WiFiManagerInit(){
+  #ifdef WM_EVENTLOG
+    #ifdef ESP32
+    logEvent(WM_EV_BOOT, (uint8_t)esp_reset_reason());
+    #else
+    logEvent(WM_EV_BOOT, (uint8_t)ESP.getResetInfoPtr()->reason);
+    #endif
+  #endif
   setMenu(_menuIdsDefault);
   if(_debug && _debugLevel >= WM_DEBUG_DEV) debugPlatformInfo();
   _max_params = WIFI_MANAGER_MAX_PARAMS;
@@ -223,6 +395,9 @@ void WiFiManager::WiFiManagerInit(){
 
 // destructor
 WiFiManager::~WiFiManager() {
+  #ifdef WM_PORTALTASK
+  portalTaskStop(); // task holds this
+  #endif
   _end();
   // parameters
   // @todo below belongs to wifimanagerparameter
@@ -475,7 +650,7 @@ bool WiFiManager::startAP(){
       #endif
       return false;
     }
-    delay(500); // workaround delay
+    // enableAP switches mode synchronously, waitForAP below covers the ip
   #endif
 
   // setup optional soft AP static ip config
@@ -528,9 +703,10 @@ bool WiFiManager::startAP(){
 
   // @todo add softAP retry here to dela with unknown failures
   
-  delay(500); // slight delay to make sure we get an AP IP
+  bool ready = ret && waitForAP(_apStartTimeout); // make sure we get an AP IP
   #ifdef WM_DEBUG_LEVEL
   if(!ret) DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] There was a problem starting the AP"));
+  else if(!ready) DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] AP start timed out"));
   DEBUG_WM(F("AP IP address:"),WiFi.softAPIP());
   #endif
 
@@ -546,19 +722,50 @@ bool WiFiManager::startAP(){
    }
   #endif
 
-  return ret;
+  return ret && ready;
+}
+
+/**
+ * wait for the softap to be started with an ip, instead of a fixed delay
+ * esp32 waits on the core AP_STARTED event bit, esp8266 starts the ap synchronously
+ * @since $dev
+ * @access private
+ * @param  unsigned long timeout ms
+ * @return bool ready
+ */
+bool WiFiManager::waitForAP(unsigned long timeout){
+  unsigned long start = millis();
+  #ifdef ESP32
+  if(!(WiFi.waitStatusBits(AP_STARTED_BIT, timeout) & AP_STARTED_BIT)) return false;
+  #endif
+  while((uint32_t)WiFi.softAPIP() == 0){
+    if(millis() - start >= timeout) return false;
+    delay(1);
+  }
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(WM_DEBUG_DEV,F("AP ready in ms:"),millis() - start);
+  #endif
+  return true;
 }
 
 /**
  * [startWebPortal description]
  * @access public
+ * @param  bool scrapeOnly serve only the WM_ROUTE_SCRAPE pages and user routes, no config, erase, restart or ota
  * @return {[type]} [description]
  */
-void WiFiManager::startWebPortal() {
+void WiFiManager::startWebPortal(bool scrapeOnly) {
   if(configPortalActive || webPortalActive) return;
   connect = abort = false;
+  _webPortalScrapeOnly = scrapeOnly;
   setupConfigPortal();
   webPortalActive = true;
+  #ifdef WM_EVENTLOG
+  logEvent(WM_EV_PORTAL_START, 1);
+  #endif
+  #ifdef WM_PORTALTASK
+  portalTaskStart();
+  #endif
 }
 
 /**
@@ -630,6 +837,14 @@ void WiFiManager::setupHTTPServer(){
   server.reset(new WM_WebServer(_httpPort));
   // This is not the safest way to reset the webserver, it can cause crashes on callbacks initilized before this and since its a shared pointer...
 
+  #ifdef WM_LANGPACK
+  // collect language header for language pack selection, set before _webservercallback, user collectHeaders will replace this
+  if(!_langpacks.empty()){
+    const char * headerkeys[] = {"Accept-Language"};
+    server->collectHeaders(headerkeys, 1);
+  }
+  #endif
+
   if ( _webservercallback != NULL) {
     #ifdef WM_DEBUG_LEVEL
     DEBUG_WM(WM_DEBUG_VERBOSE,F("[CB] _webservercallback calling"));
@@ -640,23 +855,11 @@ void WiFiManager::setupHTTPServer(){
   
   /* Setup httpd callbacks, web pages: root, wifi config pages, SO captive portal detectors and not found. */
 
-  // G macro workaround for Uri() bug https://github.com/esp8266/Arduino/issues/7102
-  server->on(WM_G(R_root),       std::bind(&WiFiManager::handleRoot, this));
-  server->on(WM_G(R_wifi),       std::bind(&WiFiManager::handleWifi, this, true));
-  server->on(WM_G(R_wifinoscan), std::bind(&WiFiManager::handleWifi, this, false));
-  server->on(WM_G(R_wifisave),   std::bind(&WiFiManager::handleWifiSave, this));
-  server->on(WM_G(R_info),       std::bind(&WiFiManager::handleInfo, this));
-  server->on(WM_G(R_param),      std::bind(&WiFiManager::handleParam, this));
-  server->on(WM_G(R_paramsave),  std::bind(&WiFiManager::handleParamSave, this));
-  server->on(WM_G(R_restart),    std::bind(&WiFiManager::handleReset, this));
-  server->on(WM_G(R_exit),       std::bind(&WiFiManager::handleExit, this));
-  server->on(WM_G(R_close),      std::bind(&WiFiManager::handleClose, this));
-  server->on(WM_G(R_erase),      std::bind(&WiFiManager::handleErase, this, false));
-  server->on(WM_G(R_status),     std::bind(&WiFiManager::handleWiFiStatus, this));
-  server->onNotFound (std::bind(&WiFiManager::handleNotFound, this));
+  // pages are dispatched from _routes, handlers added with server->on() in _webservercallback still match first
+  server->onNotFound (std::bind(&WiFiManager::handleRoute, this));
   
-  server->on(WM_G(R_update), std::bind(&WiFiManager::handleUpdate, this));
-  server->on(WM_G(R_updatedone), HTTP_POST, std::bind(&WiFiManager::handleUpdateDone, this), std::bind(&WiFiManager::handleUpdating, this));
+  // upload needs a server handler, G macro workaround for Uri() bug https://github.com/esp8266/Arduino/issues/7102
+  if(!_webPortalScrapeOnly) server->on(WM_G(R_updatedone), HTTP_POST, std::bind(&WiFiManager::handleUpdateDone, this), std::bind(&WiFiManager::handleUpdating, this));
   
   server->begin(); // Web server start
   #ifdef WM_DEBUG_LEVEL
@@ -664,16 +867,197 @@ void WiFiManager::setupHTTPServer(){
   #endif
 }
 
+// portal pages, keep sorted by uri (strcmp order) for handleRoute
+const WiFiManager::wm_route_t WiFiManager::_routes[] = {
+  {R_root,       HTTP_ANY, &WiFiManager::handleRoot, 0},
+  {R_wifinoscan, HTTP_ANY, &WiFiManager::handleWifiNoScan, WM_ROUTE_HEAVY},
+  {R_close,      HTTP_ANY, &WiFiManager::handleClose, 0},
+  {R_erase,      HTTP_ANY, &WiFiManager::handleEraseConfig, 0},
+  #ifdef WM_EVENTLOG
+  {R_events,     HTTP_ANY, &WiFiManager::handleEvents, 0},
+  #endif
+  {R_exit,       HTTP_ANY, &WiFiManager::handleExit, 0},
+  {R_info,       HTTP_ANY, &WiFiManager::handleInfo, WM_ROUTE_HEAVY},
+  {R_infojson,   HTTP_ANY, &WiFiManager::handleInfoJson, WM_ROUTE_HEAVY},
+  #ifdef WM_METRICS
+  {R_metrics,    HTTP_ANY, &WiFiManager::handleMetrics, WM_ROUTE_SCRAPE},
+  #endif
+  {R_param,      HTTP_ANY, &WiFiManager::handleParam, 0},
+  {R_paramsave,  HTTP_ANY, &WiFiManager::handleParamSave, 0},
+  {R_restart,    HTTP_ANY, &WiFiManager::handleReset, 0},
+  {R_status,     HTTP_ANY, &WiFiManager::handleWiFiStatus, 0},
+  #ifdef WM_METRICS
+  {R_statusjson, HTTP_ANY, &WiFiManager::handleStatusJson, WM_ROUTE_SCRAPE},
+  #endif
+  {R_update,     HTTP_ANY, &WiFiManager::handleUpdate, 0},
+  {R_wifi,       HTTP_ANY, &WiFiManager::handleWifiScan, WM_ROUTE_HEAVY},
+  {R_wifisave,   HTTP_ANY, &WiFiManager::handleWifiSave, 0},
+};
+
+/**
+ * dispatch a request to its route, user routes first, then a binary search of _routes
+ * @since $dev
+ * @access private
+ */
+void WiFiManager::handleRoute(){
+  String uri = server->uri();
+  const char *path = uri.c_str();
+  HTTPMethod method = server->method();
+
+  #ifdef WM_HTTPLIMIT
+  if(!httpAllow((uint32_t)server->client().remoteIP())){
+    _httpLimited++;
+    server->sendHeader(F("Retry-After"), F("1"));
+    server->send(429, FPSTR(HTTP_HEAD_CT2), F("busy"));
+    return;
+  }
+  #endif
+
+  for(uint8_t i = 0; i < _userRoutesCount; i++){
+    const wm_userroute_t &route = _userRoutes[i];
+    if(strcmp(path, route.uri) == 0 && (route.method == HTTP_ANY || route.method == method)){
+      route.func(this);
+      return;
+    }
+  }
+
+  size_t lo = 0;
+  size_t hi = sizeof(_routes) / sizeof(_routes[0]);
+  while(lo < hi){
+    size_t mid = (lo + hi) / 2;
+    int cmp = strcmp_P(path, _routes[mid].uri);
+    if(cmp == 0){
+      if(_routes[mid].method != HTTP_ANY && _routes[mid].method != method){
+        handleNotFound();
+        return;
+      }
+      if(_webPortalScrapeOnly && !(_routes[mid].flags & WM_ROUTE_SCRAPE)){
+        handleNotFound();
+        return;
+      }
+      #ifdef WM_HTTPLIMIT
+      if(!(_routes[mid].flags & WM_ROUTE_HEAVY)){
+        if(method != HTTP_GET){ // saves change what the heavy pages show
+          _coalesceRoute = -1;
+          _coalescePage  = String();
+        }
+        (this->*_routes[mid].handler)();
+        return;
+      }
+      #ifdef WM_LANGPACK
+      int8_t lang = selectLanguagePack(server->header(F("Accept-Language")));
+      #else
+      int8_t lang = -1;
+      #endif
+      bool plain = server->args() == 0 && method == HTTP_GET; // args like refresh ask for a new render
+      if(plain && _coalesceRoute == (int8_t)mid && _coalesceLang == lang && millis() - _coalesceTime < WM_HTTP_COALESCE_MS){
+        if(captivePortal()) return;
+        _httpCoalesced++;
+        handleRequest();
+        HTTPSend(_coalescePage);
+        return;
+      }
+      _coalesceRoute = -1;
+      _coalescePage  = String();
+      if(ESP.getFreeHeap() < WM_HTTP_MINHEAP){
+        _httpOverloaded++;
+        server->sendHeader(F("Retry-After"), F("2"));
+        server->send(503, FPSTR(HTTP_HEAD_CT2), F("low memory"));
+        return;
+      }
+      if(plain){
+        _coalesceCapture = mid;
+        _coalesceLang    = lang;
+      }
+      (this->*_routes[mid].handler)();
+      _coalesceCapture = -1;
+      #else
+      (this->*_routes[mid].handler)();
+      #endif
+      return;
+    }
+    if(cmp < 0) hi = mid;
+    else lo = mid + 1;
+  }
+  handleNotFound();
+}
+
+/**
+ * add a route to the portal
+ * @since $dev
+ * @access public
+ * @param  const char     *uri    path, not copied
+ * @param  wm_routefunc_t func    handler, responds through wm->server
+ * @param  HTTPMethod     method  HTTP_ANY or a single method
+ * @return bool false if WM_ROUTES_USER routes are already added
+ */
+bool WiFiManager::addRoute(const char *uri, wm_routefunc_t func, HTTPMethod method){
+  if(_userRoutesCount >= WM_ROUTES_USER){
+    #ifdef WM_DEBUG_LEVEL
+    DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] route table full, WM_ROUTES_USER"));
+    #endif
+    return false;
+  }
+  _userRoutes[_userRoutesCount++] = {uri, method, func};
+  return true;
+}
+
+#ifdef WM_HTTPLIMIT
+/**
+ * token bucket per client ip, the least recently seen client is replaced when the table is full
+ * @since $dev
+ * @access private
+ * @param  uint32_t ip client
+ * @return bool     false if the client is over WM_HTTP_RATE after its WM_HTTP_BURST
+ */
+bool WiFiManager::httpAllow(uint32_t ip){
+  const uint32_t cost = 1000 / WM_HTTP_RATE;
+  const uint32_t cap  = cost * WM_HTTP_BURST;
+  unsigned long  now  = millis();
+  uint8_t slot = 0;
+  for(uint8_t i = 0; i < WM_HTTP_CLIENTS; i++){
+    if(_httpClients[i].ip == ip){
+      slot = i;
+      break;
+    }
+    if(now - _httpClients[i].last > now - _httpClients[slot].last) slot = i;
+  }
+  if(_httpClients[slot].ip != ip){
+    _httpClients[slot].ip     = ip;
+    _httpClients[slot].credit = cap;
+    _httpClients[slot].last   = now;
+  }
+  uint32_t credit = _httpClients[slot].credit + (now - _httpClients[slot].last);
+  _httpClients[slot].credit = credit < cap ? credit : cap;
+  _httpClients[slot].last   = now;
+  if(_httpClients[slot].credit < cost) return false;
+  _httpClients[slot].credit -= cost;
+  return true;
+}
+#endif
+
 void WiFiManager::setupDNSD(){
+  #ifdef WM_FASTDNS
+  dnsServer.reset(new WiFiManagerDNS());
+  #else
   dnsServer.reset(new DNSServer());
 
   /* Setup the DNS server redirecting all the domains to the apIP */
   dnsServer->setErrorReplyCode(DNSReplyCode::NoError);
+  #endif
   #ifdef WM_DEBUG_LEVEL
   // DEBUG_WM("dns server started port: ",DNS_PORT);
   DEBUG_WM(WM_DEBUG_DEV,F("dns server started with ip: "),WiFi.softAPIP()); // @todo not showing ip
   #endif
+  #ifdef WM_FASTDNS
+  if(!dnsServer->start(DNS_PORT, WiFi.softAPIP())){
+    #ifdef WM_DEBUG_LEVEL
+    DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] dns server failed to start"));
+    #endif
+  }
+  #else
   dnsServer->start(DNS_PORT, F("*"), WiFi.softAPIP());
+  #endif
 }
 
 void WiFiManager::setupConfigPortal() {
@@ -696,6 +1080,7 @@ boolean WiFiManager::startConfigPortal() {
  */
 boolean  WiFiManager::startConfigPortal(char const *apName, char const *apPassword) {
   _begin();
+  unsigned long requested = millis();
 
   if(configPortalActive){
     #ifdef WM_DEBUG_LEVEL
@@ -703,6 +1088,7 @@ boolean  WiFiManager::startConfigPortal(char const *apName, char const *apPasswo
     #endif    
     return false;
   }
+  _webPortalScrapeOnly = false; // the config portal serves every page
 
   //setup AP
   _apName     = apName; // @todo check valid apname ?
@@ -723,7 +1109,11 @@ boolean  WiFiManager::startConfigPortal(char const *apName, char const *apPasswo
       WiFi.mode(WIFI_AP_STA);
     #endif
     WiFi_Disconnect();
+    #ifdef ESP32
+    WiFi_Mode(WIFI_AP); // one mode switch, disabling sta alone stops the radio and startAP starts it again
+    #else
     WiFi_enableSTA(false);
+    #endif
     #ifdef WM_DEBUG_LEVEL
     DEBUG_WM(WM_DEBUG_VERBOSE,F("Disabling STA"));
     #endif
@@ -734,6 +1124,13 @@ boolean  WiFiManager::startConfigPortal(char const *apName, char const *apPasswo
 
   // init configportal globals to known states
   configPortalActive = true;
+  #ifdef WM_EVENTLOG
+  logEvent(WM_EV_PORTAL_START, 0);
+  #endif
+  #ifdef WM_POWERSAVE
+  _psSuspended = true; // portal clients would see beacon interval latency
+  powerSaveApply();
+  #endif
   bool result = connect = abort = false; // loop flags, connect true success, abort true break
   uint8_t state;
 
@@ -743,7 +1140,7 @@ boolean  WiFiManager::startConfigPortal(char const *apName, char const *apPasswo
   #ifdef WM_DEBUG_LEVEL
   DEBUG_WM(WM_DEBUG_VERBOSE,F("Enabling AP"));
   #endif
-  startAP();
+  bool apReady = startAP();
   WiFiSetCountry();
 
   // do AP callback if set
@@ -764,6 +1161,15 @@ boolean  WiFiManager::startConfigPortal(char const *apName, char const *apPasswo
   DEBUG_WM(WM_DEBUG_DEV,F("setupDNSD"));
   #endif  
   setupDNSD();
+
+  // an ap that never came up is not ready, the portal keeps running in case it comes up late
+  if(apReady){
+    _portalReadyTime = millis() - requested;
+    #ifdef WM_DEBUG_LEVEL
+    DEBUG_WM(WM_DEBUG_VERBOSE,F("Config Portal ready in ms:"),_portalReadyTime);
+    #endif
+    if(_portalreadycallback != NULL) _portalreadycallback();  // @CALLBACK
+  }
   
 
   if(!_configPortalIsBlocking){
@@ -771,6 +1177,9 @@ boolean  WiFiManager::startConfigPortal(char const *apName, char const *apPasswo
       DEBUG_WM(WM_DEBUG_VERBOSE,F("Config Portal Running, non blocking (processing)"));
       if(_configPortalTimeout > 0) DEBUG_WM(WM_DEBUG_VERBOSE,F("Portal Timeout In"),(String)(_configPortalTimeout/1000) + (String)F(" seconds"));
     #endif
+    #ifdef WM_PORTALTASK
+    portalTaskStart();
+    #endif
     return result; // skip blocking loop
   }
 
@@ -812,6 +1221,10 @@ boolean  WiFiManager::startConfigPortal(char const *apName, char const *apPasswo
 
     if(!configPortalActive) break;
 
+    #ifdef WM_DEBUG_DEFERRED
+    debugFlush();
+    #endif
+
     yield(); // watchdog
   }
 
@@ -831,6 +1244,32 @@ boolean WiFiManager::process(){
     #if defined(WM_MDNS) && defined(ESP8266)
     MDNS.update();
     #endif
+
+    #ifdef WM_ROAMING
+    #ifdef WM_PORTALTASK
+    if(portalLock(0)){ // skipped while the portal task scans or connects, tried again on the next call
+      roamProcess();
+      portalUnlock();
+    }
+    #else
+    roamProcess();
+    #endif
+    #endif
+
+    #ifdef WM_DEBUG_DEFERRED
+    debugFlush();
+    #endif
+
+    #ifdef WM_EVENTLOG
+    eventLogSpill(false);
+    #endif
+
+    #ifdef WM_PORTALTASK
+    if(_portalTask && !configPortalActive && !webPortalActive) portalTaskStop(); // ended itself with a shutdown, join it
+    portalTaskDispatch(); // deferred save callbacks, on the caller's task
+    uint8_t taskstate = _portalTaskState.exchange(WL_IDLE_STATUS);
+    if(taskstate != WL_IDLE_STATUS) return taskstate == WL_CONNECTED;
+    #endif
 	
     if(webPortalActive || (configPortalActive && !_configPortalIsBlocking)){
       // if timed out or abort, break
@@ -849,12 +1288,312 @@ boolean WiFiManager::process(){
         return false;
       }
 
+      #ifdef WM_PORTALTASK
+      if(_portalTask) return false; // portal task is processing
+      #endif
+
       uint8_t state = processConfigPortal(); // state is WL_IDLE or WL_CONNECTED/FAILED
       return state == WL_CONNECTED;
     }
     return false;
 }
 
+/**
+ * getProcessDelay, how long process() has nothing to do
+ * a portal processed from process() needs it called continuously, 0
+ * @since $dev
+ * @access public
+ * @return unsigned long ms
+ */
+unsigned long WiFiManager::getProcessDelay(){
+  unsigned long wait = 1000; // nothing scheduled, look again
+
+  if(webPortalActive || (configPortalActive && !_configPortalIsBlocking)){
+    #ifdef WM_PORTALTASK
+    if(!_portalTask) return 0;
+    #else
+    return 0;
+    #endif
+    if(_allowExit && configPortalActive && _configPortalTimeout > 0){
+      unsigned long elapsed = millis() - _configPortalStart;
+      if(elapsed >= _configPortalTimeout) return 0;
+      wait = std::min(wait, _configPortalTimeout - elapsed);
+    }
+  }
+
+  #ifdef WM_PORTALTASK
+  if(_portalTaskHead != _portalTaskTail || _portalTaskState != WL_IDLE_STATUS) return 0;
+  #endif
+
+  #ifdef WM_DEBUG_DEFERRED
+  if(_debugHead != _debugTail) wait = std::min(wait, 10UL); // drain in small writes
+  #endif
+
+  #ifdef WM_ROAMING
+  if(_roaming && !configPortalActive){
+    if(_roamState) return 10; // scan or re-association in progress
+    unsigned long elapsed = millis() - _roamLastSample;
+    wait = std::min(wait, elapsed >= _roamSampleInterval ? 0 : _roamSampleInterval - elapsed);
+  }
+  #endif
+
+  return wait;
+}
+
+#ifdef WM_PORTALTASK
+/**
+ * portal task loop, runs processConfigPortal until the portal is shut down or stopped
+ * @param void* arg WiFiManager instance
+ */
+void WiFiManager::portalTask(void *arg){
+  WiFiManager *wm = (WiFiManager*)arg;
+  while(wm->_portalTaskRun && (wm->configPortalActive || wm->webPortalActive)){
+    wm->portalLock();
+    uint8_t state = wm->processConfigPortal();
+    wm->portalUnlock();
+    if(state != WL_IDLE_STATUS){
+      wm->_portalTaskState = state;
+      if(wm->_processwakecallback != NULL) wm->_processwakecallback();  // @CALLBACK
+    }
+    vTaskDelay(1);
+  }
+  // last touch of wm, portalTaskStop() may free it as soon as this is given
+  xSemaphoreGive(wm->_portalTaskDone);
+  vTaskDelete(NULL);
+}
+
+void WiFiManager::portalTaskStart(){
+  if(!_portalTaskEnabled) return;
+  portalTaskStop(); // reap a task that ended by shutting the portal down itself
+  if(_portalTask) return;
+  if(!_portalTaskDone) _portalTaskDone = xSemaphoreCreateBinary();
+  if(!_portalTaskMux) _portalTaskMux = xSemaphoreCreateRecursiveMutex();
+  if(!_portalTaskDone || !_portalTaskMux){
+    #ifdef WM_DEBUG_LEVEL
+    DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] portal task semaphores failed, using process()"));
+    #endif
+    return;
+  }
+  _portalTaskRun   = true;
+  _portalTaskState = WL_IDLE_STATUS;
+  if(xTaskCreatePinnedToCore(portalTask, "wmportal", _portalTaskStack, this, _portalTaskPriority, &_portalTask, _portalTaskCore) != pdPASS){
+    _portalTask    = NULL;
+    _portalTaskRun = false;
+    #ifdef WM_DEBUG_LEVEL
+    DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] portal task create failed, using process()"));
+    #endif
+    return;
+  }
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(WM_DEBUG_VERBOSE,F("portal task started on core:"),_portalTaskCore);
+  #endif
+}
+
+/**
+ * stop the portal task and wait for it to exit, without a timeout, the server and dns server can be freed after
+ * the task can be in a blocking connect after /wifisave, so this can take the connect timeout
+ * called from the portal task itself it only asks the task to end after the current processConfigPortal()
+ */
+void WiFiManager::portalTaskStop(){
+  if(!_portalTask) return;
+  _portalTaskRun = false;
+  if(xTaskGetCurrentTaskHandle() == _portalTask) return;
+  xSemaphoreTake(_portalTaskDone, portMAX_DELAY);
+  _portalTask = NULL;
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(WM_DEBUG_VERBOSE,F("portal task stopped"));
+  #endif
+}
+
+/**
+ * wifi, scan and portal state are shared by the portal task and process(), the task holds this around processConfigPortal()
+ * @param  TickType_t wait ticks, 0 to try
+ * @return bool        true if held, always true before the portal task was first started
+ */
+bool WiFiManager::portalLock(TickType_t wait){
+  if(!_portalTaskMux) return true;
+  return xSemaphoreTakeRecursive(_portalTaskMux, wait) == pdTRUE;
+}
+
+void WiFiManager::portalUnlock(){
+  if(_portalTaskMux) xSemaphoreGiveRecursive(_portalTaskMux);
+}
+
+/**
+ * queue a callback for process() when called from the portal task
+ * @param  uint8_t event WM_PT_xxx
+ * @return bool          false if the caller should run the callback itself
+ */
+bool WiFiManager::portalTaskDefer(uint8_t event){
+  if(!_portalTask || xTaskGetCurrentTaskHandle() != _portalTask) return false;
+  uint8_t head = _portalTaskHead.load(std::memory_order_relaxed);
+  if((uint8_t)(head - _portalTaskTail.load(std::memory_order_acquire)) >= WM_PORTALTASK_QUEUE) return false; // full, run inline
+  _portalTaskEvents[head % WM_PORTALTASK_QUEUE] = event;
+  _portalTaskHead.store(head + 1, std::memory_order_release);
+  if(_processwakecallback != NULL) _processwakecallback();  // @CALLBACK
+  return true;
+}
+
+void WiFiManager::portalTaskDispatch(){
+  uint8_t tail = _portalTaskTail.load(std::memory_order_relaxed);
+  while(tail != _portalTaskHead.load(std::memory_order_acquire)){
+    uint8_t event = _portalTaskEvents[tail % WM_PORTALTASK_QUEUE];
+    _portalTaskTail.store(++tail, std::memory_order_release);
+    if(event == WM_PT_SAVEWIFI && _savewificallback != NULL){
+      #ifdef WM_DEBUG_LEVEL
+      DEBUG_WM(WM_DEBUG_VERBOSE,F("[CB] _savewificallback calling, deferred"));
+      #endif
+      _savewificallback(); // @CALLBACK
+    }
+    else if(event == WM_PT_SAVEPARAMS && _saveparamscallback != NULL){
+      _saveparamscallback(); // @CALLBACK
+    }
+  }
+}
+#endif
+
+#ifdef WM_ROAMING
+/**
+ * roaming monitor, called from process()
+ * samples rssi, scans in the background when it stays low and re-associates to a better bssid
+ * never blocks, each call does at most one step
+ */
+void WiFiManager::roamProcess(){
+  if(!_roaming || configPortalActive) return;
+
+  if(_roamState == 2){
+    // re-associating, status still reads connected to the old ap until the disconnect is processed
+    // done once the old ap was left and the core got an ip (WL_CONNECTED) on the target bssid
+    if(WiFi.status() != WL_CONNECTED) _roamLeft = true;
+    else if(_roamLeft){
+      uint8_t *bssid = WiFi.BSSID();
+      roamDone(bssid && memcmp(bssid, _roamEvent.to, 6) == 0);
+      return;
+    }
+    if(millis() - _roamStart > _roamTimeout) roamDone(false);
+    return;
+  }
+
+  if(!WiFi.isConnected()){
+    _roamState    = 0;
+    _roamRssi     = 0;
+    _roamLowCount = 0;
+    return;
+  }
+
+  if(_roamState == 1){
+    int16_t res = WiFi.scanComplete();
+    if(res == WIFI_SCAN_RUNNING) return;
+    _roamState = 0;
+    if(res < 0) return; // failed
+    WiFi_scanComplete(res); // share the snapshot with the portal scan cache
+    if(roamSelect()){
+      _roamState = 2;
+      _roamLeft  = false;
+      _roamStart = millis();
+      WiFi.begin(WiFi_SSID(false).c_str(), WiFi_psk(false).c_str(), _roamEvent.channel, _roamEvent.to);
+    }
+    return;
+  }
+
+  if(millis() - _roamLastSample < _roamSampleInterval) return;
+  _roamLastSample = millis();
+
+  int16_t rssi = WiFi.RSSI();
+  if(rssi == 0) return; // not available
+  _roamRssi = _roamRssi == 0 ? rssi : (_roamRssi * 3 + rssi) / 4; // smooth out fades
+
+  if(_roamRssi >= _roamThreshold){
+    _roamLowCount = 0;
+    return;
+  }
+  if(_roamLowCount < _roamLowSamples) _roamLowCount++;
+  if(_roamLowCount < _roamLowSamples || (_roamLastScan && millis() - _roamLastScan < _roamScanInterval)) return;
+
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(WM_DEBUG_VERBOSE,F("[ROAM] rssi low, scanning:"),_roamRssi);
+  #endif
+  _roamLastScan = millis();
+  _startscan    = millis();
+  // async, active, short dwell per channel so traffic keeps flowing between channels
+  #ifdef ESP32
+  if(WiFi.scanNetworks(true, false, false, 120) == WIFI_SCAN_RUNNING) _roamState = 1;
+  #else
+  WiFi.scanNetworks(true);
+  _roamState = 1;
+  #endif
+}
+
+/**
+ * pick the strongest bssid of the current ssid from the last scan
+ * @return bool true if a candidate beats the current rssi by _roamHysteresis
+ */
+bool WiFiManager::roamSelect(){
+  String ssid = WiFi.SSID();
+  uint8_t *current = WiFi.BSSID();
+  int best = -1;
+  for(int i = 0; i < _numNetworks; i++){
+    if(WiFi.SSID(i) != ssid) continue;
+    if(current && memcmp(WiFi.BSSID(i), current, 6) == 0) continue;
+    if(best < 0 || WiFi.RSSI(i) > WiFi.RSSI(best)) best = i;
+  }
+  if(best < 0 || WiFi.RSSI(best) < _roamRssi + _roamHysteresis){
+    #ifdef WM_DEBUG_LEVEL
+    DEBUG_WM(WM_DEBUG_VERBOSE,F("[ROAM] no better ap found"));
+    #endif
+    return false;
+  }
+
+  memset(&_roamEvent, 0, sizeof(_roamEvent));
+  if(current) memcpy(_roamEvent.from, current, 6);
+  memcpy(_roamEvent.to, WiFi.BSSID(best), 6);
+  _roamEvent.fromRssi = _roamRssi;
+  _roamEvent.toRssi   = WiFi.RSSI(best);
+  _roamEvent.channel  = WiFi.channel(best);
+
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(F("[ROAM] roaming to:"),WiFi.BSSIDstr(best));
+  DEBUG_WM(WM_DEBUG_VERBOSE,F("[ROAM] rssi:"),_roamEvent.toRssi);
+  #endif
+  return true;
+}
+
+void WiFiManager::roamDone(bool success){
+  _roamEvent.downtime = millis() - _roamStart;
+  _roamEvent.success  = success;
+  _roamState    = 0;
+  _roamRssi     = 0;
+  _roamLowCount = 0;
+
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(success ? F("[ROAM] roamed in ms:") : F("[ROAM] roam failed after ms:"),_roamEvent.downtime);
+  #endif
+  #ifdef WM_EVENTLOG
+  logEvent(WM_EV_ROAM, success, _roamEvent.downtime);
+  #endif
+  if(success){
+    _roamCount++;
+    #ifdef WM_FASTCONNECT
+    if(_fastConnect) fastConnectSave();
+    #endif
+  }
+
+  // the roam pinned the target bssid and channel in the sta config, clear them so reconnects may use any ap again
+  // WiFi.begin() would disconnect to apply the change, so a roam that ended associated only has its pin dropped
+  // one that timed out is restarted unpinned, the core does not reconnect after the roam's own disconnect
+  if(WiFi.status() == WL_CONNECTED) WiFi_unpinSTA();
+  else {
+    String ssid = WiFi_SSID(true);
+    String psk  = WiFi_psk(true);
+    WiFi.begin(ssid.c_str(), psk.c_str());
+  }
+
+  if (_roamcallback != NULL) {
+    _roamcallback(_roamEvent);  // @CALLBACK
+  }
+}
+#endif
+
 /**
  * [processConfigPortal description]
  * using esp wl_status enums as returns for now, should be fine
@@ -903,6 +1642,9 @@ uint8_t WiFiManager::processConfigPortal(){
             #ifdef WM_DEBUG_LEVEL
             DEBUG_WM(WM_DEBUG_VERBOSE,F("[CB] _savewificallback calling"));
             #endif
+            #ifdef WM_PORTALTASK
+            if(!portalTaskDefer(WM_PT_SAVEWIFI))
+            #endif
             _savewificallback(); // @CALLBACK
           }
           if(!_connectonsave) return WL_IDLE_STATUS;
@@ -923,6 +1665,9 @@ uint8_t WiFiManager::processConfigPortal(){
           #ifdef WM_DEBUG_LEVEL
           DEBUG_WM(WM_DEBUG_VERBOSE,F("[CB] WiFi/Param save callback"));
           #endif
+          #ifdef WM_PORTALTASK
+          if(!portalTaskDefer(WM_PT_SAVEWIFI))
+          #endif
           _savewificallback(); // @CALLBACK
         }
         if(_disableConfigPortal) shutdownConfigPortal();
@@ -961,6 +1706,15 @@ bool WiFiManager::shutdownConfigPortal(){
 
   if(webPortalActive) return false;
 
+  #ifdef WM_PORTALTASK
+  portalTaskStop(); // server is freed below, portal task must be out of it
+  if(!server) return false; // the portal task shut the portal down while we waited for it
+  #endif
+
+  #ifdef WM_EVENTLOG
+  logEvent(WM_EV_PORTAL_STOP);
+  #endif
+
   if(configPortalActive){
     //DNS handler
     dnsServer->processNextRequest();
@@ -976,8 +1730,25 @@ bool WiFiManager::shutdownConfigPortal(){
 
   WiFi.scanDelete(); // free wifi scan results
 
+  #ifdef WM_LANGPACK
+  unloadLanguagePack(); // close pack file, free indexes and cached strings
+  #endif
+
+  // free cached info fields and root page
+  _infoCache[0].clear();
+  _infoCache[1].clear();
+  _rootCache = String();
+  #ifdef WM_HTTPLIMIT
+  _coalesceRoute = -1;
+  _coalescePage  = String();
+  #endif
+
   if(!configPortalActive) return false;
 
+  #if defined(WM_FASTDNS) && defined(WM_DEBUG_LEVEL)
+  DEBUG_WM(WM_DEBUG_VERBOSE,F("dns queries:"),dnsServer->getQueries());
+  DEBUG_WM(WM_DEBUG_VERBOSE,F("dns dropped:"),dnsServer->getDropped());
+  #endif
   dnsServer->stop(); //  free heap ?
   dnsServer.reset();
 
@@ -996,6 +1767,10 @@ bool WiFiManager::shutdownConfigPortal(){
   #endif
   delay(1000);
   WiFi_Mode(_usermode); // restore users wifi mode, BUG https://github.com/esp8266/Arduino/issues/4372
+  #ifdef WM_POWERSAVE
+  _psSuspended = false;
+  powerSaveApply();
+  #endif
   if(WiFi.status()==WL_IDLE_STATUS){
     WiFi.reconnect(); // restart wifi since we disconnected it in startconfigportal
     #ifdef WM_DEBUG_LEVEL
@@ -1016,11 +1791,22 @@ bool WiFiManager::shutdownConfigPortal(){
 // one for connecting to flash , one for new client
 // clean up, flow is convoluted, and causes bugs
 uint8_t WiFiManager::connectWifi(String ssid, String pass, bool connect) {
+  _wifiStateDirty = true; // credentials may change
   #ifdef WM_DEBUG_LEVEL
   DEBUG_WM(WM_DEBUG_VERBOSE,F("Connecting as wifi client..."));
   #endif
   uint8_t retry = 1;
   uint8_t connRes = (uint8_t)WL_NO_SSID_AVAIL;
+  unsigned long connStart = millis();
+  #ifdef WM_METRICS
+  _conxAttempts++;
+  #endif
+  #ifdef WM_EVENTLOG
+  logEvent(WM_EV_CONX_ATTEMPT);
+  #endif
+  #ifdef WM_FASTCONNECT
+  _fastConnected = false;
+  #endif
 
   setSTAConfig();
   //@todo catch failures in set_config
@@ -1058,7 +1844,16 @@ uint8_t WiFiManager::connectWifi(String ssid, String pass, bool connect) {
   }
   else {
     // connect using saved ssid if there is one
-    if (WiFi_hasAutoConnect()) {
+    #ifdef WM_FASTCONNECT
+    if(retry == 1 && _fastConnect && WiFi_hasAutoConnect()) connRes = wifiConnectFast(); // cached bssid/channel, skips the scan
+    #endif
+    #ifdef WM_MULTIAP
+    if(retry == 1 && connRes != WL_CONNECTED) connRes = wifiConnectMulti(); // remembered networks, best in range first
+    #endif
+    if(connRes == WL_CONNECTED){
+      // connected from cache or remembered networks
+    }
+    else if (WiFi_hasAutoConnect()) {
       wifiConnectDefault();
       connRes = waitForConnectResult();
     }
@@ -1090,6 +1885,23 @@ uint8_t WiFiManager::connectWifi(String ssid, String pass, bool connect) {
     updateConxResult(connRes);
   }
 
+  #ifdef WM_EVENTLOG
+  logEvent(WM_EV_CONX_RESULT, connRes, millis() - connStart);
+  #endif
+
+  if(connRes == WL_CONNECTED){
+    _lastconxtime = millis() - connStart;
+    #ifdef WM_DEBUG_LEVEL
+    DEBUG_WM(WM_DEBUG_VERBOSE,F("Time to IP ms:"),_lastconxtime);
+    #endif
+    #ifdef WM_FASTCONNECT
+    if(_fastConnect) fastConnectSave();
+    #endif
+    #ifdef WM_MULTIAP
+    credentialStore(WiFi_SSID(false), WiFi_psk(false));
+    #endif
+  }
+
   return connRes;
 }
 
@@ -1149,6 +1961,302 @@ bool WiFiManager::wifiConnectDefault(){
 }
 
 
+#ifdef WM_FASTCONNECT
+// cached connects missed in a row, esp32 keeps it in rtc memory so it counts over deep sleep without flash writes
+#ifdef ESP32
+RTC_DATA_ATTR
+#endif
+static uint8_t _fastConnectFails = 0;
+
+/**
+ * connect to stored wifi using the cached bssid, channel and lease of the last good connection
+ * the cached bssid and channel are unpinned after the attempt, so reconnects may roam and a fallback rescans
+ * on failure dhcp is restored, so the caller can fall back to a normal connect, the cache is
+ * dropped after WM_FASTCONNECT_FAILS misses in a row so one busy ap does not cost a flash write and a scan
+ * @since $dev
+ * @return uint8_t WL status, WL_IDLE_STATUS if nothing cached
+ */
+uint8_t WiFiManager::wifiConnectFast(){
+  wm_fastconnect_t fc;
+  String ssid = WiFi_SSID(true);
+  if(!fastConnectLoad(fc) || ssid != fc.ssid){
+    #ifdef WM_DEBUG_LEVEL
+    DEBUG_WM(WM_DEBUG_VERBOSE,F("Fast connect: no cache for"),ssid);
+    #endif
+    return WL_IDLE_STATUS;
+  }
+
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(F("Fast connect, channel:"),fc.channel);
+  #endif
+
+  WiFi_enableSTA(true,storeSTAmode);
+  bool cachedip = _fastConnectIP && fc.ip != 0 && !_sta_static_ip;
+  if(cachedip) WiFi.config(IPAddress(fc.ip), IPAddress(fc.gw), IPAddress(fc.sn), IPAddress(fc.dns));
+  WiFi.begin(ssid.c_str(), WiFi_psk(true).c_str(), fc.channel, fc.bssid);
+
+  uint8_t connRes = waitForConnectResult(_fastConnectTimeout);
+  WiFi_unpinSTA(); // the cached ap is only for this attempt, not for reconnects or the fallback
+  if(connRes == WL_CONNECTED){
+    _fastConnected    = true;
+    _fastConnectFails = 0;
+    return connRes;
+  }
+
+  // ap busy, moved, changed channel or lease is gone, fall back to a normal connect
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(F("Fast connect failed, falling back"),getWLStatusString(connRes));
+  #endif
+  if(++_fastConnectFails >= WM_FASTCONNECT_FAILS){
+    #ifdef WM_DEBUG_LEVEL
+    DEBUG_WM(WM_DEBUG_VERBOSE,F("Fast connect cache dropped after misses:"),_fastConnectFails);
+    #endif
+    fastConnectClear();
+    _fastConnectFails = 0;
+  }
+  WiFi_Disconnect();
+  if(cachedip) WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0)); // back to dhcp
+  setSTAConfig();
+  return connRes;
+}
+
+// simple checksum, only guards against stale or blank storage
+uint32_t WiFiManager::fastConnectCheck(const wm_fastconnect_t &fc){
+  const uint8_t *p = (const uint8_t*)&fc + sizeof(fc.check);
+  uint32_t sum = 0x5746434e; // WFCN
+  for(size_t i = sizeof(fc.check); i < sizeof(fc); i++) sum = (sum << 5) + sum + *p++;
+  return sum;
+}
+
+bool WiFiManager::fastConnectLoad(wm_fastconnect_t &fc){
+  bool ret = false;
+  #ifdef ESP32
+    Preferences prefs;
+    if(prefs.begin("wmfast", true)){
+      ret = prefs.getBytes("conx", &fc, sizeof(fc)) == sizeof(fc);
+      prefs.end();
+    }
+  #elif defined(ESP8266)
+    ret = ESP.rtcUserMemoryRead(0, (uint32_t*)&fc, sizeof(fc));
+  #endif
+  return ret && fc.check == fastConnectCheck(fc) && fc.channel != 0;
+}
+
+// store the current connection, only writes if something changed
+void WiFiManager::fastConnectSave(){
+  wm_fastconnect_t fc;
+  memset(&fc, 0, sizeof(fc));
+  strncpy(fc.ssid, WiFi.SSID().c_str(), sizeof(fc.ssid) - 1);
+  uint8_t *bssid = WiFi.BSSID();
+  if(bssid) memcpy(fc.bssid, bssid, sizeof(fc.bssid));
+  fc.channel = WiFi.channel();
+  if(_fastConnectIP){
+    fc.ip  = (uint32_t)WiFi.localIP();
+    fc.gw  = (uint32_t)WiFi.gatewayIP();
+    fc.sn  = (uint32_t)WiFi.subnetMask();
+    fc.dns = (uint32_t)WiFi.dnsIP();
+  }
+  fc.check = fastConnectCheck(fc);
+
+  wm_fastconnect_t old;
+  if(fastConnectLoad(old) && memcmp(&old, &fc, sizeof(fc)) == 0) return; // spare the flash
+
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(WM_DEBUG_VERBOSE,F("Fast connect cache saved, channel:"),fc.channel);
+  #endif
+  #ifdef ESP32
+    Preferences prefs;
+    if(prefs.begin("wmfast", false)){
+      prefs.putBytes("conx", &fc, sizeof(fc));
+      prefs.end();
+    }
+  #elif defined(ESP8266)
+    ESP.rtcUserMemoryWrite(0, (uint32_t*)&fc, sizeof(fc));
+  #endif
+}
+
+void WiFiManager::fastConnectClear(){
+  #ifdef ESP32
+    Preferences prefs;
+    if(prefs.begin("wmfast", false)){
+      prefs.remove("conx");
+      prefs.end();
+    }
+  #elif defined(ESP8266)
+    wm_fastconnect_t fc;
+    memset(&fc, 0, sizeof(fc));
+    ESP.rtcUserMemoryWrite(0, (uint32_t*)&fc, sizeof(fc));
+  #endif
+}
+#endif
+
+#ifdef WM_MULTIAP
+/**
+ * connect to the best remembered network in range
+ * does one scan, ranks remembered networks by rssi, recent failures and last success, then tries them in order
+ * @since $dev
+ * @return uint8_t WL status, WL_IDLE_STATUS if nothing remembered
+ */
+uint8_t WiFiManager::wifiConnectMulti(){
+  wm_credential_t creds[WM_MULTIAP_MAX];
+  if(!credentialsLoad(creds)) return WL_IDLE_STATUS;
+
+  uint32_t newest = 0;
+  for(auto &c : creds) if(c.seq > newest) newest = c.seq;
+  if(newest == 0) return WL_IDLE_STATUS;
+
+  WiFi_enableSTA(true,storeSTAmode);
+  WiFi_scanNetworks(true,false); // also refreshes the portal scan cache
+
+  typedef struct {
+    uint8_t idx;
+    int16_t score;
+    int32_t channel;
+    uint8_t bssid[6];
+  } wm_candidate_t;
+  wm_candidate_t cands[WM_MULTIAP_MAX];
+  uint8_t numcands = 0;
+
+  for(uint8_t i = 0; i < WM_MULTIAP_MAX; i++){
+    if(creds[i].seq == 0) continue;
+    int best = -1;
+    for(int n = 0; n < _numNetworks; n++){
+      if(WiFi.SSID(n) == creds[i].ssid && (best < 0 || WiFi.RSSI(n) > WiFi.RSSI(best))) best = n;
+    }
+    if(best < 0) continue;
+
+    // rssi first, each recent failure costs 8dB, last network used gets a 5dB bonus
+    wm_candidate_t cand;
+    cand.idx     = i;
+    cand.score   = WiFi.RSSI(best) - 8 * creds[i].failures + (creds[i].seq == newest ? 5 : 0);
+    cand.channel = WiFi.channel(best);
+    memcpy(cand.bssid, WiFi.BSSID(best), sizeof(cand.bssid));
+
+    uint8_t pos = numcands++;
+    while(pos > 0 && cands[pos-1].score < cand.score){
+      cands[pos] = cands[pos-1];
+      pos--;
+    }
+    cands[pos] = cand;
+  }
+
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(WM_DEBUG_VERBOSE,F("Remembered networks in range:"),numcands);
+  #endif
+
+  // candidates are tried in ram storage, a failed one must not replace the network saved in nvs
+  // the saved config is put back if none connects, so the plain WiFi.begin() fallback uses it
+  wifi_config_t saved;
+  if(esp_wifi_get_config(WIFI_IF_STA, &saved) != ESP_OK) memset(&saved, 0, sizeof(saved));
+  WiFi_storageRAM(true);
+
+  uint8_t connRes = WL_NO_SSID_AVAIL;
+  bool changed = false;
+  bool persist = false;
+  for(uint8_t i = 0; i < numcands; i++){
+    wm_credential_t &c = creds[cands[i].idx];
+    #ifdef WM_DEBUG_LEVEL
+    DEBUG_WM(F("Connecting to remembered AP:"),c.ssid);
+    DEBUG_WM(WM_DEBUG_VERBOSE,F("Score:"),cands[i].score);
+    #endif
+    // bssid is not set to not pin a single ap
+    WiFi.begin(c.ssid, c.pass, cands[i].channel, NULL);
+    connRes = waitForConnectResult(_multiAPTimeout);
+    if(connRes == WL_CONNECTED){
+      persist = strncmp((const char*)saved.sta.ssid, c.ssid, sizeof(saved.sta.ssid)) != 0
+             || strncmp((const char*)saved.sta.password, c.pass, sizeof(saved.sta.password)) != 0;
+      break;
+    }
+    if(c.failures < 255) c.failures++;
+    changed = true;
+    WiFi_Disconnect();
+  }
+
+  if(connRes == WL_CONNECTED) WiFi_unpinSTA(); // candidate channel, reconnects may use any
+  else if(numcands > 0) esp_wifi_set_config(WIFI_IF_STA, &saved);
+  WiFi_storageRAM(false);
+  if(persist) credentialPersist();
+
+  if(changed) credentialsSave(creds);
+  return connRes;
+}
+
+/**
+ * write the connected network to the driver's nvs config, so a plain WiFi.begin() and the next boot use it
+ * candidates are tried with ram storage, only the one that connects costs a flash write
+ * @since $dev
+ */
+void WiFiManager::credentialPersist(){
+  wifi_config_t conf;
+  if(esp_wifi_get_config(WIFI_IF_STA, &conf) != ESP_OK) return;
+  esp_wifi_set_storage(WIFI_STORAGE_FLASH);
+  bool ret = esp_wifi_set_config(WIFI_IF_STA, &conf) == ESP_OK;
+  WiFi_storageRAM(false); // back to the core's mode, flash unless persistence was turned off
+  #ifdef WM_DEBUG_LEVEL
+  if(!ret) DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] wifi config save failed"));
+  else DEBUG_WM(WM_DEBUG_VERBOSE,F("Saved wifi config for"),(const char*)conf.sta.ssid);
+  #endif
+}
+
+bool WiFiManager::credentialsLoad(wm_credential_t *creds){
+  memset(creds, 0, sizeof(wm_credential_t) * WM_MULTIAP_MAX);
+  Preferences prefs;
+  if(!prefs.begin("wmcreds", true)) return false;
+  bool ret = prefs.getBytes("ring", creds, sizeof(wm_credential_t) * WM_MULTIAP_MAX) == sizeof(wm_credential_t) * WM_MULTIAP_MAX;
+  prefs.end();
+  if(!ret) memset(creds, 0, sizeof(wm_credential_t) * WM_MULTIAP_MAX); // missing or WM_MULTIAP_MAX changed
+  return ret;
+}
+
+void WiFiManager::credentialsSave(const wm_credential_t *creds){
+  Preferences prefs;
+  if(!prefs.begin("wmcreds", false)){
+    #ifdef WM_DEBUG_LEVEL
+    DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] credentials save failed"));
+    #endif
+    return;
+  }
+  prefs.putBytes("ring", creds, sizeof(wm_credential_t) * WM_MULTIAP_MAX);
+  prefs.end();
+}
+
+/**
+ * remember a network as the most recent good one, only writes flash if something changed
+ * @since $dev
+ * @return bool success
+ */
+bool WiFiManager::credentialStore(const String &ssid, const String &pass){
+  if(ssid == "" || ssid.length() >= sizeof(wm_credential_t::ssid) || pass.length() >= sizeof(wm_credential_t::pass)) return false;
+
+  wm_credential_t creds[WM_MULTIAP_MAX];
+  credentialsLoad(creds);
+
+  uint32_t newest = 0;
+  int8_t slot = -1;
+  int8_t oldest = 0;
+  for(uint8_t i = 0; i < WM_MULTIAP_MAX; i++){
+    if(creds[i].seq > newest) newest = creds[i].seq;
+    if(creds[i].seq < creds[oldest].seq) oldest = i;
+    if(creds[i].seq && ssid == creds[i].ssid) slot = i;
+  }
+
+  if(slot >= 0 && creds[slot].seq == newest && creds[slot].failures == 0 && pass == creds[slot].pass) return true; // nothing to do
+  if(slot < 0) slot = oldest; // empty slots have seq 0
+
+  wm_credential_t &c = creds[slot];
+  memset(&c, 0, sizeof(c));
+  strncpy(c.ssid, ssid.c_str(), sizeof(c.ssid) - 1);
+  strncpy(c.pass, pass.c_str(), sizeof(c.pass) - 1);
+  c.seq = newest + 1;
+  credentialsSave(creds);
+
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(WM_DEBUG_VERBOSE,F("Remembered network:"),ssid);
+  #endif
+  return true;
+}
+#endif
+
 /**
  * set sta config if set
  * @since $dev
@@ -1274,7 +2382,7 @@ void WiFiManager::startWPS() {
 
 String WiFiManager::getHTTPHead(String title){
   String page;
-  page += FPSTR(HTTP_HEAD_START);
+  page += WM_LS(HTTP_HEAD_START);
   page.replace(FPSTR(T_v), title);
   page += FPSTR(HTTP_SCRIPT);
   page += FPSTR(HTTP_STYLE);
@@ -1293,6 +2401,14 @@ String WiFiManager::getHTTPHead(String title){
 }
 
 void WiFiManager::HTTPSend(const String &content){
+  #ifdef WM_HTTPLIMIT
+  if(_coalesceCapture >= 0){ // heavy page rendered by handleRoute, serve it again for a while
+    _coalescePage    = content;
+    _coalesceRoute   = _coalesceCapture;
+    _coalesceTime    = millis();
+    _coalesceCapture = -1;
+  }
+  #endif
   server->send(200, FPSTR(HTTP_HEAD_CT), content);
 }
 
@@ -1301,6 +2417,19 @@ void WiFiManager::HTTPSend(const String &content){
  */
 void WiFiManager::handleRequest() {
   _webPortalAccessed = millis();
+  #ifdef ESP32
+  if(wm_event_id == 0) _wifiStateDirty = true; // no event listener, refresh once per request
+  #else
+  _wifiStateDirty = true; // no event listener, refresh once per request
+  #endif
+  #ifdef WM_METRICS
+  _portalHits++;
+  #endif
+
+  #ifdef WM_LANGPACK
+  // select language pack for this request
+  _langpackSelected = selectLanguagePack(server->header(F("Accept-Language")));
+  #endif
 
   // TESTING HTTPD AUTH RFC 2617
   // BASIC_AUTH will hold onto creds, hard to "logout", but convienent
@@ -1332,13 +2461,29 @@ void WiFiManager::handleRoot() {
   #endif
   if (captivePortal()) return; // If captive portal redirect instead of displaying the page
   handleRequest();
-  String page = getHTTPHead(_title); // @token options @todo replace options with title
-  String str  = FPSTR(HTTP_ROOT_MAIN); // @todo custom title
-  str.replace(FPSTR(T_t),_title);
-  str.replace(FPSTR(T_v),configPortalActive ? _apName : (getWiFiHostname() + " - " + WiFi.localIP().toString())); // use ip if ap is not active for heading @todo use hostname?
-  page += str;
-  page += FPSTR(HTTP_PORTAL_OPTIONS);
-  page += getMenuOut();
+  String heading = configPortalActive ? _apName : (getWiFiHostname() + " - " + getWiFiState().ip.toString()); // use ip if ap is not active for heading @todo use hostname?
+  #ifdef WM_LANGPACK
+  int8_t lang = _langpackSelected;
+  #else
+  int8_t lang = -1;
+  #endif
+
+  // head, heading and menu only change with config, captive portal checkers reload this page often
+  if(_rootCache.length() == 0 || lang != _rootCacheLang || heading != _rootCacheHeading){
+    _rootCache = getHTTPHead(_title); // @token options @todo replace options with title
+    String str  = FPSTR(HTTP_ROOT_MAIN); // @todo custom title
+    str.replace(FPSTR(T_t),_title);
+    str.replace(FPSTR(T_v),heading);
+    _rootCache += str;
+    _rootCache += FPSTR(HTTP_PORTAL_OPTIONS);
+    _rootCache += getMenuOut();
+    _rootCacheHeading = heading;
+    _rootCacheLang    = lang;
+  }
+
+  String page;
+  page.reserve(_rootCache.length() + 512);
+  page += _rootCache;
   reportStatus(page);
   page += FPSTR(HTTP_END);
 
@@ -1349,6 +2494,15 @@ void WiFiManager::handleRoot() {
   // if we can detect these and ignore them that would be great, since they come from the captive portal redirect maybe there is a refferer
 }
 
+// route table entries for handleWifi
+void WiFiManager::handleWifiScan() {
+  handleWifi(true);
+}
+
+void WiFiManager::handleWifiNoScan() {
+  handleWifi(false);
+}
+
 /**
  * HTTPD CALLBACK Wifi config page handler
  */
@@ -1357,7 +2511,7 @@ void WiFiManager::handleWifi(boolean scan) {
   DEBUG_WM(WM_DEBUG_VERBOSE,F("<- HTTP Wifi"));
   #endif
   handleRequest();
-  String page = getHTTPHead(FPSTR(S_titlewifi)); // @token titlewifi
+  String page = getHTTPHead(WM_LS(S_titlewifi)); // @token titlewifi
   if (scan) {
     #ifdef WM_DEBUG_LEVEL
     // DEBUG_WM(WM_DEBUG_DEV,"refresh flag:",server->hasArg(F("refresh")));
@@ -1371,14 +2525,15 @@ void WiFiManager::handleWifi(boolean scan) {
   pitem.replace(FPSTR(T_v), F("wifisave")); // set form action
   page += pitem;
 
-  pitem = FPSTR(HTTP_FORM_WIFI);
-  pitem.replace(FPSTR(T_v), WiFi_SSID());
+  const wm_wifistate_t &state = getWiFiState();
+  pitem = WM_LS(HTTP_FORM_WIFI);
+  pitem.replace(FPSTR(T_v), state.ssid);
 
   if(_showPassword){
-    pitem.replace(FPSTR(T_p), WiFi_psk());
+    pitem.replace(FPSTR(T_p), state.psk);
   }
-  else if(WiFi_psk() != ""){
-    pitem.replace(FPSTR(T_p),FPSTR(S_passph));    
+  else if(state.psk != ""){
+    pitem.replace(FPSTR(T_p),WM_LS(S_passph));    
   }
   else {
     pitem.replace(FPSTR(T_p),"");    
@@ -1392,9 +2547,9 @@ void WiFiManager::handleWifi(boolean scan) {
     page += FPSTR(HTTP_FORM_PARAM_HEAD);
     page += getParamOut();
   }
-  page += FPSTR(HTTP_FORM_END);
-  page += FPSTR(HTTP_SCAN_LINK);
-  if(_showBack) page += FPSTR(HTTP_BACKBTN);
+  page += WM_LS(HTTP_FORM_END);
+  page += WM_LS(HTTP_SCAN_LINK);
+  if(_showBack) page += WM_LS(HTTP_BACKBTN);
   reportStatus(page);
   page += FPSTR(HTTP_END);
 
@@ -1413,7 +2568,7 @@ void WiFiManager::handleParam(){
   DEBUG_WM(WM_DEBUG_VERBOSE,F("<- HTTP Param"));
   #endif
   handleRequest();
-  String page = getHTTPHead(FPSTR(S_titleparam)); // @token titlewifi
+  String page = getHTTPHead(WM_LS(S_titleparam)); // @token titlewifi
 
   String pitem = "";
 
@@ -1422,8 +2577,8 @@ void WiFiManager::handleParam(){
   page += pitem;
 
   page += getParamOut();
-  page += FPSTR(HTTP_FORM_END);
-  if(_showBack) page += FPSTR(HTTP_BACKBTN);
+  page += WM_LS(HTTP_FORM_END);
+  if(_showBack) page += WM_LS(HTTP_BACKBTN);
   reportStatus(page);
   page += FPSTR(HTTP_END);
 
@@ -1439,12 +2594,12 @@ String WiFiManager::getMenuOut(){
   String page;  
 
   for(auto menuId :_menuIds ){
-    if((String)_menutokens[menuId] == "param" && _paramsCount == 0) continue; // no params set, omit params from menu, @todo this may be undesired by someone, use only menu to force?
-    if((String)_menutokens[menuId] == "custom" && _customMenuHTML!=NULL){
+    if(strcmp_P("param", _menutokens[menuId]) == 0 && _paramsCount == 0) continue; // no params set, omit params from menu, @todo this may be undesired by someone, use only menu to force?
+    if(strcmp_P("custom", _menutokens[menuId]) == 0 && _customMenuHTML!=NULL){
       page += _customMenuHTML;
       continue;
     }
-    page += HTTP_PORTAL_MENU[menuId];
+    page += WM_LSM(menuId);
     delay(0);
   }
 
@@ -1563,7 +2718,7 @@ String WiFiManager::WiFiManager::getScanItemOut(){
       #ifdef WM_DEBUG_LEVEL
       DEBUG_WM(F("No networks found"));
       #endif
-      page += FPSTR(S_nonetworks); // @token nonetworks
+      page += WM_LS(S_nonetworks); // @token nonetworks
       page += F("<br/><br/>");
     }
     else {
@@ -1695,16 +2850,16 @@ String WiFiManager::getStaticOut(){
     #endif
     page += FPSTR(HTTP_FORM_STATIC_HEAD);
     // @todo how can we get these accurate settings from memory , wifi_get_ip_info does not seem to reveal if struct ip_info is static or not
-    page += getIpForm(FPSTR(S_ip),FPSTR(S_staticip),(_sta_static_ip ? _sta_static_ip.toString() : "")); // @token staticip
+    page += getIpForm(FPSTR(S_ip),WM_LS(S_staticip),(_sta_static_ip ? _sta_static_ip.toString() : "")); // @token staticip
     // WiFi.localIP().toString();
-    page += getIpForm(FPSTR(S_gw),FPSTR(S_staticgw),(_sta_static_gw ? _sta_static_gw.toString() : "")); // @token staticgw
+    page += getIpForm(FPSTR(S_gw),WM_LS(S_staticgw),(_sta_static_gw ? _sta_static_gw.toString() : "")); // @token staticgw
     // WiFi.gatewayIP().toString();
-    page += getIpForm(FPSTR(S_sn),FPSTR(S_subnet),(_sta_static_sn ? _sta_static_sn.toString() : "")); // @token subnet
+    page += getIpForm(FPSTR(S_sn),WM_LS(S_subnet),(_sta_static_sn ? _sta_static_sn.toString() : "")); // @token subnet
     // WiFi.subnetMask().toString();
   }
 
   if((_staShowDns || _sta_static_dns) && _staShowDns>=0){
-    page += getIpForm(FPSTR(S_dns),FPSTR(S_staticdns),(_sta_static_dns ? _sta_static_dns.toString() : "")); // @token dns
+    page += getIpForm(FPSTR(S_dns),WM_LS(S_staticdns),(_sta_static_dns ? _sta_static_dns.toString() : "")); // @token dns
   }
 
   if(page!="") page += FPSTR(HTTP_BR); // @todo remove these, use css
@@ -1810,6 +2965,9 @@ void WiFiManager::handleWifiSave() {
   DEBUG_WM(WM_DEBUG_DEV,F("Method:"),server->method() == HTTP_GET  ? (String)FPSTR(S_GET) : (String)FPSTR(S_POST));
   #endif
   handleRequest();
+  #ifdef WM_EVENTLOG
+  logEvent(WM_EV_WIFI_SAVE);
+  #endif
 
   //SAVE/connect here
   _ssid = server->arg(F("s")).c_str();
@@ -1878,15 +3036,15 @@ void WiFiManager::handleWifiSave() {
   String page;
 
   if(_ssid == ""){
-    page = getHTTPHead(FPSTR(S_titlewifisettings)); // @token titleparamsaved
-    page += FPSTR(HTTP_PARAMSAVED);
+    page = getHTTPHead(WM_LS(S_titlewifisettings)); // @token titleparamsaved
+    page += WM_LS(HTTP_PARAMSAVED);
   }
   else {
-    page = getHTTPHead(FPSTR(S_titlewifisaved)); // @token titlewifisaved
-    page += FPSTR(HTTP_SAVED);
+    page = getHTTPHead(WM_LS(S_titlewifisaved)); // @token titlewifisaved
+    page += WM_LS(HTTP_SAVED);
   }
 
-  if(_showBack) page += FPSTR(HTTP_BACKBTN);
+  if(_showBack) page += WM_LS(HTTP_BACKBTN);
   page += FPSTR(HTTP_END);
 
   server->sendHeader(FPSTR(HTTP_HEAD_CORS), FPSTR(HTTP_HEAD_CORS_ALLOW_ALL)); // @HTTPHEAD send cors
@@ -1911,9 +3069,9 @@ void WiFiManager::handleParamSave() {
 
   doParamSave();
 
-  String page = getHTTPHead(FPSTR(S_titleparamsaved)); // @token titleparamsaved
-  page += FPSTR(HTTP_PARAMSAVED);
-  if(_showBack) page += FPSTR(HTTP_BACKBTN); 
+  String page = getHTTPHead(WM_LS(S_titleparamsaved)); // @token titleparamsaved
+  page += WM_LS(HTTP_PARAMSAVED);
+  if(_showBack) page += WM_LS(HTTP_BACKBTN); 
   page += FPSTR(HTTP_END);
 
   HTTPSend(page);
@@ -1924,6 +3082,9 @@ void WiFiManager::handleParamSave() {
 }
 
 void WiFiManager::doParamSave(){
+  #ifdef WM_EVENTLOG
+  logEvent(WM_EV_PARAM_SAVE, _paramsCount);
+  #endif
    // @todo use new callback for before paramsaves, is this really needed?
   if ( _presaveparamscallback != NULL) {
     _presaveparamscallback();  // @CALLBACK
@@ -1964,11 +3125,92 @@ void WiFiManager::doParamSave(){
   }
 
    if ( _saveparamscallback != NULL) {
+    #ifdef WM_PORTALTASK
+    if(!portalTaskDefer(WM_PT_SAVEPARAMS))
+    #endif
     _saveparamscallback();  // @CALLBACK
   }
    
 }
 
+// info field names, json keys and getInfoData(String) lookups
+#define WM_INFO_NAME(id, vol) #id,
+#define WM_INFO_VOLATILE(id, vol) vol,
+static const char * const _infonames[] PROGMEM = { WM_INFO_FIELDS(WM_INFO_NAME) };
+static const bool _infovolatile[] = { WM_INFO_FIELDS(WM_INFO_VOLATILE) };
+
+// info page field order
+#ifdef ESP8266
+static const wm_info_t _infoids[] = {
+  WM_INFO_esphead,
+  WM_INFO_uptime,
+  WM_INFO_chipid,
+  WM_INFO_fchipid,
+  WM_INFO_idesize,
+  WM_INFO_flashsize,
+  WM_INFO_corever,
+  WM_INFO_bootver,
+  WM_INFO_cpufreq,
+  WM_INFO_freeheap,
+  WM_INFO_memsketch,
+  WM_INFO_memsmeter,
+  WM_INFO_lastreset,
+  WM_INFO_wifihead,
+  WM_INFO_conx,
+  WM_INFO_stassid,
+  WM_INFO_rssi,
+  WM_INFO_staip,
+  WM_INFO_stagw,
+  WM_INFO_stasub,
+  WM_INFO_dnss,
+  WM_INFO_host,
+  WM_INFO_stamac,
+  WM_INFO_autoconx,
+  WM_INFO_apssid,
+  WM_INFO_apip,
+  WM_INFO_apbssid,
+  WM_INFO_apmac
+};
+#elif defined(ESP32)
+// add esp_chip_info ?
+static const wm_info_t _infoids[] = {
+  WM_INFO_esphead,
+  WM_INFO_uptime,
+  WM_INFO_chipid,
+  WM_INFO_chiprev,
+  WM_INFO_idesize,
+  WM_INFO_flashsize,
+  WM_INFO_cpufreq,
+  WM_INFO_freeheap,
+  WM_INFO_memsketch,
+  WM_INFO_memsmeter,
+  WM_INFO_lastreset,
+  WM_INFO_temp,
+  WM_INFO_wifihead,
+  WM_INFO_conx,
+  WM_INFO_stassid,
+  WM_INFO_rssi,
+  WM_INFO_staip,
+  WM_INFO_stagw,
+  WM_INFO_stasub,
+  WM_INFO_dnss,
+  WM_INFO_host,
+  WM_INFO_stamac,
+  WM_INFO_apssid,
+  WM_INFO_apip,
+  WM_INFO_apmac,
+  WM_INFO_aphost,
+  WM_INFO_apbssid
+};
+#endif
+
+static const wm_info_t _infoaboutids[] = {
+  WM_INFO_aboutver,
+  WM_INFO_aboutarduinover,
+  WM_INFO_aboutsdkver,
+  WM_INFO_aboutdate
+};
+
 /** 
  * HTTPD CALLBACK info page
  */
@@ -1977,100 +3219,28 @@ void WiFiManager::handleInfo() {
   DEBUG_WM(WM_DEBUG_VERBOSE,F("<- HTTP Info"));
   #endif
   handleRequest();
-  String page = getHTTPHead(FPSTR(S_titleinfo)); // @token titleinfo
+  String page = getHTTPHead(WM_LS(S_titleinfo)); // @token titleinfo
   reportStatus(page);
 
-  uint16_t infos = 0;
-
-  //@todo convert to enum or refactor to strings
   //@todo wrap in build flag to remove all info code for memory saving
-  #ifdef ESP8266
-    infos = 28;
-    String infoids[] = {
-      F("esphead"),
-      F("uptime"),
-      F("chipid"),
-      F("fchipid"),
-      F("idesize"),
-      F("flashsize"),
-      F("corever"),
-      F("bootver"),
-      F("cpufreq"),
-      F("freeheap"),
-      F("memsketch"),
-      F("memsmeter"),
-      F("lastreset"),
-      F("wifihead"),
-      F("conx"),
-      F("stassid"),
-      F("staip"),
-      F("stagw"),
-      F("stasub"),
-      F("dnss"),
-      F("host"),
-      F("stamac"),
-      F("autoconx"),
-      F("wifiaphead"),
-      F("apssid"),
-      F("apip"),
-      F("apbssid"),
-      F("apmac")
-    };
-
-  #elif defined(ESP32)
-    // add esp_chip_info ?
-    infos = 27;
-    String infoids[] = {
-      F("esphead"),
-      F("uptime"),
-      F("chipid"),
-      F("chiprev"),
-      F("idesize"),
-      F("flashsize"),      
-      F("cpufreq"),
-      F("freeheap"),
-      F("memsketch"),
-      F("memsmeter"),      
-      F("lastreset"),
-      F("temp"),
-      // F("hall"),
-      F("wifihead"),
-      F("conx"),
-      F("stassid"),
-      F("staip"),
-      F("stagw"),
-      F("stasub"),
-      F("dnss"),
-      F("host"),
-      F("stamac"),
-      F("apssid"),
-      F("wifiaphead"),
-      F("apip"),
-      F("apmac"),
-      F("aphost"),
-      F("apbssid")
-    };
-  #endif
-
-  for(size_t i=0; i<infos;i++){
-    if(infoids[i] != NULL) page += getInfoData(infoids[i]);
+  for(wm_info_t id : _infoids){
+    page += getInfoData(id);
   }
   page += F("</dl>");
 
   page += F("<h3>About</h3><hr><dl>");
-  page += getInfoData("aboutver");
-  page += getInfoData("aboutarduinover");
-  page += getInfoData("aboutidfver");
-  page += getInfoData("aboutdate");
+  for(wm_info_t id : _infoaboutids){
+    page += getInfoData(id);
+  }
   page += F("</dl>");
 
   if(_showInfoUpdate){
-    page += HTTP_PORTAL_MENU[8];
-    page += HTTP_PORTAL_MENU[9];
+    page += WM_LSM(8);
+    page += WM_LSM(9);
   }
-  if(_showInfoErase) page += FPSTR(HTTP_ERASEBTN);
-  if(_showBack) page += FPSTR(HTTP_BACKBTN);
-  page += FPSTR(HTTP_HELP);
+  if(_showInfoErase) page += WM_LS(HTTP_ERASEBTN);
+  if(_showBack) page += WM_LS(HTTP_BACKBTN);
+  page += WM_LS(HTTP_HELP);
   page += FPSTR(HTTP_END);
 
   HTTPSend(page);
@@ -2080,240 +3250,613 @@ void WiFiManager::handleInfo() {
   #endif
 }
 
-String WiFiManager::getInfoData(String id){
+/** 
+ * HTTPD CALLBACK info json, same fields as the info page keyed by field id
+ * values are strings, fields with 2 values are arrays
+ */
+void WiFiManager::handleInfoJson() {
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(WM_DEBUG_VERBOSE,F("<- HTTP Info JSON"));
+  #endif
+  handleRequest();
+  String page = F("{");
 
-  String p;
-  if(id==F("esphead")){
-    p = FPSTR(HTTP_INFO_esphead);
-    #ifdef ESP32
-      p.replace(FPSTR(T_1), (String)ESP.getChipModel());
-    #endif
-  }
-  else if(id==F("wifihead")){
-    p = FPSTR(HTTP_INFO_wifihead);
-    p.replace(FPSTR(T_1),getModeString(WiFi.getMode()));
+  for(wm_info_t id : _infoids){
+    String item = getInfoData(id, true);
+    if(item == "") continue;
+    if(page.length() > 1) page += ',';
+    page += item;
   }
-  else if(id==F("uptime")){
-    // subject to rollover!
-    p = FPSTR(HTTP_INFO_uptime);
-    p.replace(FPSTR(T_1),(String)(millis() / 1000 / 60));
-    p.replace(FPSTR(T_2),(String)((millis() / 1000) % 60));
+  for(wm_info_t id : _infoaboutids){
+    String item = getInfoData(id, true);
+    if(item == "") continue;
+    if(page.length() > 1) page += ',';
+    page += item;
   }
-  else if(id==F("chipid")){
-    p = FPSTR(HTTP_INFO_chipid);
-    p.replace(FPSTR(T_1),String(WIFI_getChipId(),HEX));
+  page += '}';
+
+  server->sendHeader(FPSTR(HTTP_HEAD_CORS), FPSTR(HTTP_HEAD_CORS_ALLOW_ALL)); // @HTTPHEAD send cors
+  server->send(200, FPSTR(HTTP_HEAD_CTJSON), page);
+
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(WM_DEBUG_DEV,F("Sent info json"));
+  #endif
+}
+
+/**
+ * get info field by name, kept for callers using the old string ids
+ * @param  String id info field name, eg. "uptime"
+ * @return String rendered html
+ */
+String WiFiManager::getInfoData(String id){
+  for(uint8_t i = 0; i < WM_INFO_MAX; i++){
+    if(id.equals(FPSTR(_infonames[i]))) return getInfoData((wm_info_t)i);
   }
-  #ifdef ESP32
-  else if(id==F("chiprev")){
-      p = FPSTR(HTTP_INFO_chiprev);
-      String rev = (String)ESP.getChipRevision();
-      #ifdef _SOC_EFUSE_REG_H_
-        String revb = (String)(REG_READ(EFUSE_BLK0_RDATA3_REG) >> (EFUSE_RD_CHIP_VER_RESERVE_S)&&EFUSE_RD_CHIP_VER_RESERVE_V);
-        p.replace(FPSTR(T_1),rev+"<br/>"+revb);
-      #else
-        p.replace(FPSTR(T_1),rev);
-      #endif
+  return "";
+}
+
+/**
+ * render an info field as html or a json member
+ * static fields are rendered once and cached until the portal shuts down
+ * @param  wm_info_t id
+ * @param  bool json   json member "id":"value" instead of html
+ * @return String empty if field is not available on this platform
+ */
+String WiFiManager::getInfoData(wm_info_t id, bool json){
+  std::vector<String> &cache = _infoCache[json ? 1 : 0];
+  bool cacheable = !_infovolatile[id];
+  if(cacheable){
+    if(cache.size() != WM_INFO_MAX) cache.resize(WM_INFO_MAX);
+    else if(cache[id] != "") return cache[id];
   }
-  #endif
-  #ifdef ESP8266
-  else if(id==F("fchipid")){
-      p = FPSTR(HTTP_INFO_fchipid);
-      p.replace(FPSTR(T_1),(String)ESP.getFlashChipId());
+
+  String v1, v2;
+  PGM_P tpl = getInfoValues(id, v1, v2);
+  if(!tpl) return "";
+
+  String p;
+  if(json){
+    if(v1 == "" || id == WM_INFO_memsmeter) return ""; // heads and duplicates
+    p = '"';
+    p += FPSTR(_infonames[id]);
+    p += F("\":");
+    if(v2 == ""){
+      p += '"' + jsonEscape(v1) + '"';
+    }
+    else {
+      p += F("[\"");
+      p += jsonEscape(v1);
+      p += F("\",\"");
+      p += jsonEscape(v2);
+      p += F("\"]");
+    }
   }
-  #endif
-  else if(id==F("idesize")){
-    p = FPSTR(HTTP_INFO_idesize);
-    p.replace(FPSTR(T_1),(String)ESP.getFlashChipSize());
+  else {
+    if(id == WM_INFO_stassid || id == WM_INFO_apssid){
+      v1 = htmlEntities(v1);
+    }
+    p = FPSTR(tpl);
+    p.replace(FPSTR(T_1),v1);
+    p.replace(FPSTR(T_2),v2);
   }
-  else if(id==F("flashsize")){
+
+  if(cacheable) cache[id] = p;
+  return p;
+}
+
+/**
+ * raw values for an info field
+ * @param  wm_info_t id
+ * @param  String v1 {1} value
+ * @param  String v2 {2} value
+ * @return PGM_P html template, NULL if field is not available on this platform
+ */
+PGM_P WiFiManager::getInfoValues(wm_info_t id, String &v1, String &v2){
+  switch(id){
+    case WM_INFO_esphead:
+      #ifdef ESP32
+        v1 = (String)ESP.getChipModel();
+      #endif
+      return HTTP_INFO_esphead;
+    case WM_INFO_wifihead:
+      v1 = getModeString(WiFi.getMode());
+      return HTTP_INFO_wifihead;
+    case WM_INFO_uptime:
+    {
+      // subject to rollover!
+      unsigned long secs = millis() / 1000;
+      v1 = (String)(secs / 60);
+      v2 = (String)(secs % 60);
+      return HTTP_INFO_uptime;
+    }
+    case WM_INFO_chipid:
+      v1 = String(WIFI_getChipId(),HEX);
+      return HTTP_INFO_chipid;
+    #ifdef ESP32
+    case WM_INFO_chiprev:
+      v1 = (String)ESP.getChipRevision();
+      #ifdef _SOC_EFUSE_REG_H_
+        v1 += "<br/>" + (String)(REG_READ(EFUSE_BLK0_RDATA3_REG) >> (EFUSE_RD_CHIP_VER_RESERVE_S)&&EFUSE_RD_CHIP_VER_RESERVE_V);
+      #endif
+      return HTTP_INFO_chiprev;
+    #endif
     #ifdef ESP8266
-      p = FPSTR(HTTP_INFO_flashsize);
-      p.replace(FPSTR(T_1),(String)ESP.getFlashChipRealSize());
-    #elif defined ESP32
-      p = FPSTR(HTTP_INFO_psrsize);
-      p.replace(FPSTR(T_1),(String)ESP.getPsramSize());      
+    case WM_INFO_fchipid:
+      v1 = (String)ESP.getFlashChipId();
+      return HTTP_INFO_fchipid;
     #endif
-  }
-  else if(id==F("corever")){
+    case WM_INFO_idesize:
+      v1 = (String)ESP.getFlashChipSize();
+      return HTTP_INFO_idesize;
+    case WM_INFO_flashsize:
+      #ifdef ESP8266
+        v1 = (String)ESP.getFlashChipRealSize();
+        return HTTP_INFO_flashsize;
+      #elif defined ESP32
+        v1 = (String)ESP.getPsramSize();
+        return HTTP_INFO_psrsize;
+      #endif
     #ifdef ESP8266
-      p = FPSTR(HTTP_INFO_corever);
-      p.replace(FPSTR(T_1),(String)ESP.getCoreVersion());
-    #endif      
-  }
-  #ifdef ESP8266
-  else if(id==F("bootver")){
-      p = FPSTR(HTTP_INFO_bootver);
-      p.replace(FPSTR(T_1),(String)system_get_boot_version());
-  }
-  #endif
-  else if(id==F("cpufreq")){
-    p = FPSTR(HTTP_INFO_cpufreq);
-    p.replace(FPSTR(T_1),(String)ESP.getCpuFreqMHz());
-  }
-  else if(id==F("freeheap")){
-    p = FPSTR(HTTP_INFO_freeheap);
-    p.replace(FPSTR(T_1),(String)ESP.getFreeHeap());
-  }
-  else if(id==F("memsketch")){
-    p = FPSTR(HTTP_INFO_memsketch);
-    p.replace(FPSTR(T_1),(String)(ESP.getSketchSize()));
-    p.replace(FPSTR(T_2),(String)(ESP.getSketchSize()+ESP.getFreeSketchSpace()));
-  }
-  else if(id==F("memsmeter")){
-    p = FPSTR(HTTP_INFO_memsmeter);
-    p.replace(FPSTR(T_1),(String)(ESP.getSketchSize()));
-    p.replace(FPSTR(T_2),(String)(ESP.getSketchSize()+ESP.getFreeSketchSpace()));
-  }
-  else if(id==F("lastreset")){
+    case WM_INFO_corever:
+      v1 = (String)ESP.getCoreVersion();
+      return HTTP_INFO_corever;
+    case WM_INFO_bootver:
+      v1 = (String)system_get_boot_version();
+      return HTTP_INFO_bootver;
+    #endif
+    case WM_INFO_cpufreq:
+      v1 = (String)ESP.getCpuFreqMHz();
+      return HTTP_INFO_cpufreq;
+    case WM_INFO_freeheap:
+      v1 = (String)ESP.getFreeHeap();
+      return HTTP_INFO_freeheap;
+    case WM_INFO_memsketch:
+    case WM_INFO_memsmeter:
+      v1 = (String)(ESP.getSketchSize());
+      v2 = (String)(ESP.getSketchSize()+ESP.getFreeSketchSpace());
+      return id == WM_INFO_memsketch ? HTTP_INFO_memsketch : HTTP_INFO_memsmeter;
+    case WM_INFO_lastreset:
     #ifdef ESP8266
-      p = FPSTR(HTTP_INFO_lastreset);
-      p.replace(FPSTR(T_1),(String)ESP.getResetReason());
+      v1 = (String)ESP.getResetReason();
+      return HTTP_INFO_lastreset;
     #elif defined(ESP32) && defined(_ROM_RTC_H_)
       // requires #include <rom/rtc.h>
-      p = FPSTR(HTTP_INFO_lastreset);
       for(int i=0;i<2;i++){
-        int reason = rtc_get_reset_reason(i);
-        String tok = (String)T_ss+(String)(i+1)+(String)T_es;
-        switch (reason)
+        String &v = i ? v2 : v1;
+        switch (rtc_get_reset_reason(i))
         {
           //@todo move to array
-          case 1  : p.replace(tok,F("Vbat power on reset"));break;
-          case 3  : p.replace(tok,F("Software reset digital core"));break;
-          case 4  : p.replace(tok,F("Legacy watch dog reset digital core"));break;
-          case 5  : p.replace(tok,F("Deep Sleep reset digital core"));break;
-          case 6  : p.replace(tok,F("Reset by SLC module, reset digital core"));break;
-          case 7  : p.replace(tok,F("Timer Group0 Watch dog reset digital core"));break;
-          case 8  : p.replace(tok,F("Timer Group1 Watch dog reset digital core"));break;
-          case 9  : p.replace(tok,F("RTC Watch dog Reset digital core"));break;
-          case 10 : p.replace(tok,F("Instrusion tested to reset CPU"));break;
-          case 11 : p.replace(tok,F("Time Group reset CPU"));break;
-          case 12 : p.replace(tok,F("Software reset CPU"));break;
-          case 13 : p.replace(tok,F("RTC Watch dog Reset CPU"));break;
-          case 14 : p.replace(tok,F("for APP CPU, reseted by PRO CPU"));break;
-          case 15 : p.replace(tok,F("Reset when the vdd voltage is not stable"));break;
-          case 16 : p.replace(tok,F("RTC Watch dog reset digital core and rtc module"));break;
-          default : p.replace(tok,F("NO_MEAN"));
+          case 1  : v = F("Vbat power on reset");break;
+          case 3  : v = F("Software reset digital core");break;
+          case 4  : v = F("Legacy watch dog reset digital core");break;
+          case 5  : v = F("Deep Sleep reset digital core");break;
+          case 6  : v = F("Reset by SLC module, reset digital core");break;
+          case 7  : v = F("Timer Group0 Watch dog reset digital core");break;
+          case 8  : v = F("Timer Group1 Watch dog reset digital core");break;
+          case 9  : v = F("RTC Watch dog Reset digital core");break;
+          case 10 : v = F("Instrusion tested to reset CPU");break;
+          case 11 : v = F("Time Group reset CPU");break;
+          case 12 : v = F("Software reset CPU");break;
+          case 13 : v = F("RTC Watch dog Reset CPU");break;
+          case 14 : v = F("for APP CPU, reseted by PRO CPU");break;
+          case 15 : v = F("Reset when the vdd voltage is not stable");break;
+          case 16 : v = F("RTC Watch dog reset digital core and rtc module");break;
+          default : v = F("NO_MEAN");
         }
       }
+      return HTTP_INFO_lastreset;
+    #else
+      return NULL;
     #endif
+    case WM_INFO_apip:
+      v1 = WiFi.softAPIP().toString();
+      return HTTP_INFO_apip;
+    case WM_INFO_apmac:
+      v1 = (String)WiFi.softAPmacAddress();
+      return HTTP_INFO_apmac;
+    #ifdef ESP32
+    case WM_INFO_aphost:
+      v1 = WiFi.softAPgetHostname();
+      return HTTP_INFO_aphost;
+    #endif
+    #ifndef WM_NOSOFTAPSSID
+    #ifdef ESP8266
+    case WM_INFO_apssid:
+      v1 = WiFi.softAPSSID();
+      return HTTP_INFO_apssid;
+    #endif
+    #endif
+    case WM_INFO_apbssid:
+      v1 = (String)WiFi.BSSIDstr();
+      return HTTP_INFO_apbssid;
+    // softAPgetHostname // esp32
+    // softAPSubnetCIDR
+    // softAPNetworkID
+    // softAPBroadcastIP
+
+    case WM_INFO_stassid:
+      v1 = getWiFiState().ssid;
+      return HTTP_INFO_stassid;
+    case WM_INFO_rssi:
+      if(!WiFi.isConnected()) return NULL;
+      v1 = (String)WiFi.RSSI();
+      return HTTP_INFO_rssi;
+    case WM_INFO_staip:
+      v1 = getWiFiState().ip.toString();
+      return HTTP_INFO_staip;
+    case WM_INFO_stagw:
+      v1 = WiFi.gatewayIP().toString();
+      return HTTP_INFO_stagw;
+    case WM_INFO_stasub:
+      v1 = WiFi.subnetMask().toString();
+      return HTTP_INFO_stasub;
+    case WM_INFO_dnss:
+      v1 = WiFi.dnsIP().toString();
+      return HTTP_INFO_dnss;
+    case WM_INFO_host:
+      #ifdef ESP32
+        v1 = WiFi.getHostname();
+      #else
+        v1 = WiFi.hostname();
+      #endif
+      return HTTP_INFO_host;
+    case WM_INFO_stamac:
+      v1 = WiFi.macAddress();
+      return HTTP_INFO_stamac;
+    case WM_INFO_conx:
+      v1 = WiFi.isConnected() ? WM_LS(S_y) : WM_LS(S_n);
+      return HTTP_INFO_conx;
+    #ifdef ESP8266
+    case WM_INFO_autoconx:
+      v1 = WiFi.getAutoConnect() ? FPSTR(S_enable) : FPSTR(S_disable);
+      return HTTP_INFO_autoconx;
+    #endif
+    #if defined(ESP32) && !defined(WM_NOTEMP)
+    case WM_INFO_temp:
+    {
+      // temperature is not calibrated, varying large offsets are present, use for relative temp changes only
+      float temp = temperatureRead();
+      v1 = (String)temp;
+      v2 = (String)((temp+32)*1.8f);
+      return HTTP_INFO_temp;
+    }
+    // case WM_INFO_hall:
+    //   v1 = (String)hallRead(); // hall sensor reads can cause issues with adcs
+    //   return HTTP_INFO_hall;
+    #endif
+    case WM_INFO_aboutver:
+      v1 = FPSTR(WM_VERSION_STR);
+      return HTTP_INFO_aboutver;
+    #ifdef VER_ARDUINO_STR
+    case WM_INFO_aboutarduinover:
+      v1 = String(VER_ARDUINO_STR);
+      return HTTP_INFO_aboutarduino;
+    #endif
+    case WM_INFO_aboutsdkver:
+      #ifdef ESP32
+        v1 = (String)esp_get_idf_version();
+        // v1 = (String)system_get_sdk_version(); // deprecated
+      #else
+        v1 = (String)system_get_sdk_version();
+      #endif
+      return HTTP_INFO_sdkver;
+    case WM_INFO_aboutdate:
+      v1 = String(__DATE__ " " __TIME__);
+      return HTTP_INFO_aboutdate;
+    default:
+      return NULL;
   }
-  else if(id==F("apip")){
-    p = FPSTR(HTTP_INFO_apip);
-    p.replace(FPSTR(T_1),WiFi.softAPIP().toString());
-  }
-  else if(id==F("apmac")){
-    p = FPSTR(HTTP_INFO_apmac);
-    p.replace(FPSTR(T_1),(String)WiFi.softAPmacAddress());
+}
+
+#ifdef WM_METRICS
+/**
+ * add a user gauge to the scrape endpoints
+ * @since $dev
+ * @access public
+ * @param  char* name   metric name, not copied, prefixed with wm_ in /metrics
+ * @param  func         returns current value, called on every scrape
+ * @return bool         false if WM_METRICS_USER gauges already added
+ */
+bool WiFiManager::addMetric(const char *name, std::function<int32_t()> func){
+  if(_metricsCount >= WM_METRICS_USER){
+    #ifdef WM_DEBUG_LEVEL
+    DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] addMetric, max metrics reached, WM_METRICS_USER:"),WM_METRICS_USER);
+    #endif
+    return false;
   }
+  _metrics[_metricsCount].name = name;
+  _metrics[_metricsCount].func = func;
+  _metricsCount++;
+  return true;
+}
+
+/**
+ * render status into _metricsBuf
+ * @since $dev
+ * @param  bool prom prometheus text format, else json
+ * @return size_t length rendered
+ */
+size_t WiFiManager::renderMetrics(bool prom){
+  uint32_t uptime;
+  uint32_t heapmin;
+  uint32_t heapmax;
   #ifdef ESP32
-  else if(id==F("aphost")){
-      p = FPSTR(HTTP_INFO_aphost);
-      p.replace(FPSTR(T_1),WiFi.softAPgetHostname());
-  }
-  #endif
-  #ifndef WM_NOSOFTAPSSID
-  #ifdef ESP8266
-  else if(id==F("apssid")){
-    p = FPSTR(HTTP_INFO_apssid);
-    p.replace(FPSTR(T_1),htmlEntities(WiFi.softAPSSID()));
-  }
-  #endif
+    uptime  = (uint32_t)(esp_timer_get_time() / 1000000ULL); // does not roll over with millis
+    heapmin = ESP.getMinFreeHeap();
+    heapmax = ESP.getMaxAllocHeap();
+  #else
+    uptime  = millis() / 1000;
+    heapmin = ESP.getFreeHeap(); // no low water mark on esp8266
+    heapmax = ESP.getMaxFreeBlockSize();
   #endif
-  else if(id==F("apbssid")){
-    p = FPSTR(HTTP_INFO_apbssid);
-    p.replace(FPSTR(T_1),(String)WiFi.BSSIDstr());
-  }
-  // softAPgetHostname // esp32
-  // softAPSubnetCIDR
-  // softAPNetworkID
-  // softAPBroadcastIP
-
-  else if(id==F("stassid")){
-    p = FPSTR(HTTP_INFO_stassid);
-    p.replace(FPSTR(T_1),htmlEntities((String)WiFi_SSID()));
-  }
-  else if(id==F("staip")){
-    p = FPSTR(HTTP_INFO_staip);
-    p.replace(FPSTR(T_1),WiFi.localIP().toString());
-  }
-  else if(id==F("stagw")){
-    p = FPSTR(HTTP_INFO_stagw);
-    p.replace(FPSTR(T_1),WiFi.gatewayIP().toString());
-  }
-  else if(id==F("stasub")){
-    p = FPSTR(HTTP_INFO_stasub);
-    p.replace(FPSTR(T_1),WiFi.subnetMask().toString());
-  }
-  else if(id==F("dnss")){
-    p = FPSTR(HTTP_INFO_dnss);
-    p.replace(FPSTR(T_1),WiFi.dnsIP().toString());
+  int32_t rssi = WiFi.isConnected() ? WiFi.RSSI() : 0;
+
+  size_t len = 0;
+  size_t size = sizeof(_metricsBuf) - (prom ? 0 : 1); // room for the closing brace of the json
+  bool truncated = false;
+  int n;
+  if(prom){
+    n = snprintf_P(_metricsBuf, size, PSTR(
+      "# TYPE wm_conx_result gauge\nwm_conx_result %u\n"
+      "# TYPE wm_connected gauge\nwm_connected %u\n"
+      "# TYPE wm_rssi_dbm gauge\nwm_rssi_dbm %d\n"
+      "# TYPE wm_connect_ms gauge\nwm_connect_ms %u\n"
+      "# TYPE wm_portal_ready_ms gauge\nwm_portal_ready_ms %u\n"
+      "# TYPE wm_connect_attempts_total counter\nwm_connect_attempts_total %u\n"
+      "# TYPE wm_sta_disconnects_total counter\nwm_sta_disconnects_total %u\n"
+      "# TYPE wm_portal_requests_total counter\nwm_portal_requests_total %u\n"
+      "# TYPE wm_heap_free_bytes gauge\nwm_heap_free_bytes %u\n"
+      "# TYPE wm_heap_min_free_bytes gauge\nwm_heap_min_free_bytes %u\n"
+      "# TYPE wm_heap_max_alloc_bytes gauge\nwm_heap_max_alloc_bytes %u\n"
+      "# TYPE wm_uptime_seconds counter\nwm_uptime_seconds %u\n"),
+      (unsigned)_lastconxresult, (unsigned)WiFi.isConnected(), (int)rssi, (unsigned)_lastconxtime,
+      (unsigned)_portalReadyTime, (unsigned)_conxAttempts, (unsigned)_staDisconnects, (unsigned)_portalHits,
+      (unsigned)ESP.getFreeHeap(), (unsigned)heapmin, (unsigned)heapmax, (unsigned)uptime);
   }
-  else if(id==F("host")){
-    p = FPSTR(HTTP_INFO_host);
-    #ifdef ESP32
-      p.replace(FPSTR(T_1),WiFi.getHostname());
-    #else
-    p.replace(FPSTR(T_1),WiFi.hostname());
-    #endif
-  }
-  else if(id==F("stamac")){
-    p = FPSTR(HTTP_INFO_stamac);
-    p.replace(FPSTR(T_1),WiFi.macAddress());
+  else {
+    n = snprintf_P(_metricsBuf, size, PSTR(
+      "{\"conx_result\":%u,\"connected\":%u,\"rssi\":%d,\"connect_ms\":%u,\"portal_ready_ms\":%u,\"connect_attempts\":%u,\"sta_disconnects\":%u,"
+      "\"portal_requests\":%u,\"heap_free\":%u,\"heap_min_free\":%u,\"heap_max_alloc\":%u,\"uptime\":%u"),
+      (unsigned)_lastconxresult, (unsigned)WiFi.isConnected(), (int)rssi, (unsigned)_lastconxtime,
+      (unsigned)_portalReadyTime, (unsigned)_conxAttempts, (unsigned)_staDisconnects, (unsigned)_portalHits,
+      (unsigned)ESP.getFreeHeap(), (unsigned)heapmin, (unsigned)heapmax, (unsigned)uptime);
   }
-  else if(id==F("conx")){
-    p = FPSTR(HTTP_INFO_conx);
-    p.replace(FPSTR(T_1),WiFi.isConnected() ? FPSTR(S_y) : FPSTR(S_n));
+  if(n > 0 && (size_t)n < size) len = n; // only whole sections, a cut off one is dropped
+  else truncated = true;
+
+  // last ota upload
+  if(prom){
+    n = snprintf_P(_metricsBuf + len, size - len, PSTR(
+      "# TYPE wm_ota_bytes gauge\nwm_ota_bytes %u\n"
+      "# TYPE wm_ota_kbps gauge\nwm_ota_kbps %u\n"
+      "# TYPE wm_ota_chunk_max_us gauge\nwm_ota_chunk_max_us %u\n"
+      "# TYPE wm_ota_write_max_us gauge\nwm_ota_write_max_us %u\n"
+      "# TYPE wm_ota_stalls gauge\nwm_ota_stalls %u\n"
+      "# TYPE wm_ota_error gauge\nwm_ota_error %u\n"),
+      (unsigned)_otaStats.bytes, (unsigned)_otaStats.kbps, (unsigned)_otaStats.chunkMaxUs,
+      (unsigned)_otaStats.writeMaxUs, (unsigned)_otaStats.stalls, (unsigned)_otaStats.error);
   }
-  #ifdef ESP8266
-  else if(id==F("autoconx")){
-    p = FPSTR(HTTP_INFO_autoconx);
-    p.replace(FPSTR(T_1),WiFi.getAutoConnect() ? FPSTR(S_enable) : FPSTR(S_disable));
+  else {
+    n = snprintf_P(_metricsBuf + len, size - len, PSTR(
+      ",\"ota\":{\"bytes\":%u,\"kbps\":%u,\"chunk_max_us\":%u,\"write_max_us\":%u,\"stalls\":%u,\"error\":%u}"),
+      (unsigned)_otaStats.bytes, (unsigned)_otaStats.kbps, (unsigned)_otaStats.chunkMaxUs,
+      (unsigned)_otaStats.writeMaxUs, (unsigned)_otaStats.stalls, (unsigned)_otaStats.error);
   }
+  if(n > 0 && (size_t)n < size - len) len += n;
+  else truncated = true;
+
+  #ifdef WM_ROAMING
+  if(prom) n = snprintf_P(_metricsBuf + len, size - len, PSTR(
+    "# TYPE wm_roams_total counter\nwm_roams_total %u\n"
+    "# TYPE wm_roam_downtime_ms gauge\nwm_roam_downtime_ms %u\n"),
+    (unsigned)_roamCount, (unsigned)_roamEvent.downtime);
+  else n = snprintf_P(_metricsBuf + len, size - len, PSTR(",\"roams\":%u,\"roam_downtime_ms\":%u"),
+    (unsigned)_roamCount, (unsigned)_roamEvent.downtime);
+  if(n > 0 && (size_t)n < size - len) len += n;
+  else truncated = true;
+  #endif
+
+  #ifdef WM_HTTPLIMIT
+  if(prom) n = snprintf_P(_metricsBuf + len, size - len, PSTR(
+    "# TYPE wm_http_limited_total counter\nwm_http_limited_total %u\n"
+    "# TYPE wm_http_overloaded_total counter\nwm_http_overloaded_total %u\n"
+    "# TYPE wm_http_coalesced_total counter\nwm_http_coalesced_total %u\n"),
+    (unsigned)_httpLimited, (unsigned)_httpOverloaded, (unsigned)_httpCoalesced);
+  else n = snprintf_P(_metricsBuf + len, size - len, PSTR(",\"http_limited\":%u,\"http_overloaded\":%u,\"http_coalesced\":%u"),
+    (unsigned)_httpLimited, (unsigned)_httpOverloaded, (unsigned)_httpCoalesced);
+  if(n > 0 && (size_t)n < size - len) len += n;
+  else truncated = true;
+  #endif
+
+  #ifdef WM_POWERSAVE
+  if(prom) n = snprintf_P(_metricsBuf + len, size - len, PSTR(
+    "# TYPE wm_powersave gauge\nwm_powersave %u\n"
+    "# TYPE wm_powersave_interval_ms gauge\nwm_powersave_interval_ms %lu\n"),
+    (unsigned)(_psSuspended ? WIFI_PS_NONE : _powerSave), getPowerSaveInterval());
+  else n = snprintf_P(_metricsBuf + len, size - len, PSTR(",\"powersave\":%u,\"powersave_interval_ms\":%lu"),
+    (unsigned)(_psSuspended ? WIFI_PS_NONE : _powerSave), getPowerSaveInterval());
+  if(n > 0 && (size_t)n < size - len) len += n;
+  else truncated = true;
   #endif
-  #if defined(ESP32) && !defined(WM_NOTEMP)
-  else if(id==F("temp")){
-    // temperature is not calibrated, varying large offsets are present, use for relative temp changes only
-    p = FPSTR(HTTP_INFO_temp);
-    p.replace(FPSTR(T_1),(String)temperatureRead());
-    p.replace(FPSTR(T_2),(String)((temperatureRead()+32)*1.8f));
+
+  for(uint8_t i = 0; i < _metricsCount && !truncated; i++){
+    long value = (long)_metrics[i].func();
+    if(prom) n = snprintf_P(_metricsBuf + len, size - len, PSTR("# TYPE wm_%s gauge\nwm_%s %ld\n"), _metrics[i].name, _metrics[i].name, value);
+    else n = snprintf_P(_metricsBuf + len, size - len, PSTR(",\"%s\":%ld"), _metrics[i].name, value);
+    if(n > 0 && (size_t)n < size - len) len += n;
+    else truncated = true;
   }
-  // else if(id==F("hall")){ 
-  //   p = FPSTR(HTTP_INFO_hall);
-  //   p.replace(FPSTR(T_1),(String)hallRead()); // hall sensor reads can cause issues with adcs
-  // }
+
+  if(!prom) _metricsBuf[len++] = '}';
+  _metricsBuf[len] = '\0'; // a dropped section may have left part of itself past len
+
+  #ifdef WM_DEBUG_LEVEL
+  if(truncated) DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] metrics truncated, increase WM_METRICS_BUFSIZE"));
+  #endif
+  return len;
+}
+
+/** 
+ * HTTPD CALLBACK status json, for fleet scraping
+ * does not count as a portal request or extend the portal timeout
+ */
+void WiFiManager::handleStatusJson() {
+  size_t len = renderMetrics(false);
+  server->sendHeader(FPSTR(HTTP_HEAD_CORS), FPSTR(HTTP_HEAD_CORS_ALLOW_ALL)); // @HTTPHEAD send cors
+  server->send_P(200, HTTP_HEAD_CTJSON, _metricsBuf, len);
+}
+
+/** 
+ * HTTPD CALLBACK prometheus metrics
+ */
+void WiFiManager::handleMetrics() {
+  size_t len = renderMetrics(true);
+  server->send_P(200, HTTP_HEAD_CTPROM, _metricsBuf, len);
+}
+#endif
+
+#ifdef WM_EVENTLOG
+/**
+ * add an event to the ram log, oldest event is overwritten when full
+ * @since $dev
+ * @access public
+ * @param uint8_t id  wm_event_t
+ * @param uint8_t arg
+ * @param int32_t val
+ */
+void WiFiManager::logEvent(uint8_t id, uint8_t arg, int32_t val){
+  #ifdef ESP32
+  portENTER_CRITICAL(&_eventMux);
+  #endif
+  wm_eventrec_t &e = _events[_eventCount % WM_EVENTLOG_SIZE];
+  e.ms  = millis();
+  e.seq = (uint16_t)_eventCount;
+  e.id  = id;
+  e.arg = arg;
+  e.val = val;
+  _eventCount++;
+  #ifdef ESP32
+  portEXIT_CRITICAL(&_eventMux);
+  #endif
+}
+
+/**
+ * copy the ram log into buf, see extras/eventlog.js for the format
+ * @since $dev
+ * @access public
+ * @param  uint8_t* buf
+ * @param  size_t   size
+ * @return size_t   bytes written, 0 if buf is smaller than the header
+ */
+size_t WiFiManager::readEventLog(uint8_t *buf, size_t size){
+  if(size < sizeof(wm_eventhdr_t)) return 0;
+  wm_eventhdr_t hdr = { {'W','M','E','V'}, 1, sizeof(wm_eventrec_t), 0, (uint32_t)millis() };
+  size_t room = (size - sizeof(hdr)) / sizeof(wm_eventrec_t);
+
+  #ifdef ESP32
+  portENTER_CRITICAL(&_eventMux);
   #endif
-  else if(id==F("aboutver")){
-    p = FPSTR(HTTP_INFO_aboutver);
-    p.replace(FPSTR(T_1),FPSTR(WM_VERSION_STR));
+  uint32_t count = _eventCount < WM_EVENTLOG_SIZE ? _eventCount : WM_EVENTLOG_SIZE;
+  if(count > room) count = room;
+  uint8_t *rec = buf + sizeof(hdr);
+  for(uint32_t i = _eventCount - count; i != _eventCount; i++){
+    memcpy(rec, &_events[i % WM_EVENTLOG_SIZE], sizeof(wm_eventrec_t));
+    rec += sizeof(wm_eventrec_t);
   }
-  else if(id==F("aboutarduinover")){
-    #ifdef VER_ARDUINO_STR
-    p = FPSTR(HTTP_INFO_aboutarduino);
-    p.replace(FPSTR(T_1),String(VER_ARDUINO_STR));
+  #ifdef ESP32
+  portEXIT_CRITICAL(&_eventMux);
+  #endif
+
+  hdr.count = count;
+  memcpy(buf, &hdr, sizeof(hdr));
+  return sizeof(hdr) + count * sizeof(wm_eventrec_t);
+}
+
+/**
+ * spill events to a file before the ring overwrites them
+ * @since $dev
+ * @access public
+ * @param fs::FS      fs
+ * @param const char* path, not copied
+ * @param size_t      max  file size before rotating to path.1
+ */
+void WiFiManager::setEventLogSpill(fs::FS &fs, const char *path, size_t max){
+  _eventFS      = &fs;
+  _eventPath    = path;
+  _eventMax     = max;
+  _eventSpilled = _eventCount > WM_EVENTLOG_SIZE ? _eventCount - WM_EVENTLOG_SIZE : 0;
+}
+
+void WiFiManager::flushEventLog(){
+  eventLogSpill(true);
+}
+
+/**
+ * append unsaved events to the spill file, from process() once half the ring is unsaved
+ * @param bool force write any unsaved events
+ */
+void WiFiManager::eventLogSpill(bool force){
+  if(!_eventFS) return;
+  uint32_t count = _eventCount;
+  if(count == _eventSpilled || (!force && count - _eventSpilled < WM_EVENTLOG_SIZE / 2)) return;
+  if(count - _eventSpilled > WM_EVENTLOG_SIZE) _eventSpilled = count - WM_EVENTLOG_SIZE; // overwritten, lost
+
+  File file = _eventFS->open(_eventPath, "a");
+  if(!file) return;
+  wm_eventrec_t rec;
+  for(; _eventSpilled != count; _eventSpilled++){
+    #ifdef ESP32
+    portENTER_CRITICAL(&_eventMux);
     #endif
-  }
-  // else if(id==F("aboutidfver")){
-  //   #ifdef VER_IDF_STR
-  //   p = FPSTR(HTTP_INFO_aboutidf);
-  //   p.replace(FPSTR(T_1),String(VER_IDF_STR));
-  //   #endif
-  // }
-  else if(id==F("aboutsdkver")){
-    p = FPSTR(HTTP_INFO_sdkver);
+    rec = _events[_eventSpilled % WM_EVENTLOG_SIZE];
     #ifdef ESP32
-      p.replace(FPSTR(T_1),(String)esp_get_idf_version());
-      // p.replace(FPSTR(T_1),(String)system_get_sdk_version()); // deprecated
-    #else
-    p.replace(FPSTR(T_1),(String)system_get_sdk_version());
+    portEXIT_CRITICAL(&_eventMux);
     #endif
+    file.write((const uint8_t*)&rec, sizeof(rec));
   }
-  else if(id==F("aboutdate")){
-    p = FPSTR(HTTP_INFO_aboutdate);
-    p.replace(FPSTR(T_1),String(__DATE__ " " __TIME__));
+  size_t size = file.size();
+  file.close();
+
+  if(size >= _eventMax){
+    String old = (String)_eventPath + ".1";
+    _eventFS->remove(old.c_str());
+    _eventFS->rename(_eventPath, old.c_str());
   }
-  return p;
 }
 
+/** 
+ * HTTPD CALLBACK binary event log, ?file=1 serves the spill file instead of ram
+ * does not count as a portal request or extend the portal timeout
+ */
+void WiFiManager::handleEvents() {
+  size_t size = sizeof(wm_eventhdr_t) + WM_EVENTLOG_SIZE * sizeof(wm_eventrec_t);
+  File file;
+  if(server->hasArg(F("file")) && _eventFS){
+    eventLogSpill(true);
+    file = _eventFS->open(_eventPath, "r");
+    if(file) size = sizeof(wm_eventhdr_t) + (file.size() / sizeof(wm_eventrec_t)) * sizeof(wm_eventrec_t);
+  }
+  std::unique_ptr<uint8_t[]> buf(new (std::nothrow) uint8_t[size]);
+  if(!buf){
+    if(file) file.close();
+    server->send(500, FPSTR(HTTP_HEAD_CT2), F("no memory"));
+    return;
+  }
+
+  size_t len;
+  if(file){
+    wm_eventhdr_t hdr = { {'W','M','E','V'}, 1, sizeof(wm_eventrec_t), 0, (uint32_t)millis() };
+    len = sizeof(hdr) + file.read(buf.get() + sizeof(hdr), size - sizeof(hdr));
+    file.close();
+    hdr.count = (len - sizeof(hdr)) / sizeof(wm_eventrec_t);
+    memcpy(buf.get(), &hdr, sizeof(hdr));
+  }
+  else len = readEventLog(buf.get(), size);
+
+  server->send_P(200, HTTP_HEAD_CTBIN, (const char*)buf.get(), len);
+}
+#endif
+
 /** 
  * HTTPD CALLBACK exit, closes configportal if blocking, if non blocking undefined
  */
@@ -2322,8 +3865,8 @@ void WiFiManager::handleExit() {
   DEBUG_WM(WM_DEBUG_VERBOSE,F("<- HTTP Exit"));
   #endif
   handleRequest();
-  String page = getHTTPHead(FPSTR(S_titleexit)); // @token titleexit
-  page += FPSTR(S_exiting); // @token exiting
+  String page = getHTTPHead(WM_LS(S_titleexit)); // @token titleexit
+  page += WM_LS(S_exiting); // @token exiting
   // ('Logout', 401, {'WWW-Authenticate': 'Basic realm="Login required"'})
   server->sendHeader(F("Cache-Control"), F("no-cache, no-store, must-revalidate")); // @HTTPHEAD send cache
   HTTPSend(page);
@@ -2339,8 +3882,8 @@ void WiFiManager::handleReset() {
   DEBUG_WM(WM_DEBUG_VERBOSE,F("<- HTTP Reset"));
   #endif
   handleRequest();
-  String page = getHTTPHead(FPSTR(S_titlereset)); //@token titlereset
-  page += FPSTR(S_resetting); //@token resetting
+  String page = getHTTPHead(WM_LS(S_titlereset)); //@token titlereset
+  page += WM_LS(S_resetting); //@token resetting
   page += FPSTR(HTTP_END);
 
   HTTPSend(page);
@@ -2359,18 +3902,22 @@ void WiFiManager::handleReset() {
 // void WiFiManager::handleErase() {
 //   handleErase(false);
 // }
+void WiFiManager::handleEraseConfig() {
+  handleErase(false);
+}
+
 void WiFiManager::handleErase(boolean opt) {
   #ifdef WM_DEBUG_LEVEL
   DEBUG_WM(WM_DEBUG_NOTIFY,F("<- HTTP Erase"));
   #endif
   handleRequest();
-  String page = getHTTPHead(FPSTR(S_titleerase)); // @token titleerase
+  String page = getHTTPHead(WM_LS(S_titleerase)); // @token titleerase
 
   bool ret = erase(opt);
 
-  if(ret) page += FPSTR(S_resetting); // @token resetting
+  if(ret) page += WM_LS(S_resetting); // @token resetting
   else {
-    page += FPSTR(S_error); // @token erroroccur
+    page += WM_LS(S_error); // @token erroroccur
     #ifdef WM_DEBUG_LEVEL
     DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] WiFi EraseConfig failed"));
     #endif
@@ -2394,7 +3941,7 @@ void WiFiManager::handleErase(boolean opt) {
 void WiFiManager::handleNotFound() {
   if (captivePortal()) return; // If captive portal redirect instead of displaying the page
   handleRequest();
-  String message = FPSTR(S_notfound); // @token notfound
+  String message = WM_LS(S_notfound); // @token notfound
 
   bool verbose404 = false; // show info in 404 body, uri,method, args
   if(verbose404){
@@ -2469,44 +4016,61 @@ void WiFiManager::handleClose(){
   DEBUG_WM(WM_DEBUG_VERBOSE,F("<- HTTP close"));
   #endif
   handleRequest();
-  String page = getHTTPHead(FPSTR(S_titleclose)); // @token titleclose
-  page += FPSTR(S_closing); // @token closing
+  String page = getHTTPHead(WM_LS(S_titleclose)); // @token titleclose
+  page += WM_LS(S_closing); // @token closing
   HTTPSend(page);
 }
 
+/**
+ * wifi state snapshot for page rendering, read from the driver only after it changed
+ * @since $dev
+ * @access private
+ * @return wm_wifistate_t status, configured ssid and psk, station ip
+ */
+const WiFiManager::wm_wifistate_t& WiFiManager::getWiFiState(){
+  if(_wifiStateDirty.exchange(false)){ // cleared first, an event during the read marks it again
+    _wifiState.status = WiFi.status();
+    _wifiState.ssid   = WiFi_SSID();
+    _wifiState.psk    = WiFi_psk();
+    _wifiState.ip     = WiFi.localIP();
+  }
+  return _wifiState;
+}
+
 void WiFiManager::reportStatus(String &page){
   // updateConxResult(WiFi.status()); // @todo: this defeats the purpose of last result, update elsewhere or add logic here
+  const wm_wifistate_t &state = getWiFiState();
   DEBUG_WM(WM_DEBUG_DEV,F("[WIFI] reportStatus prev:"),getWLStatusString(_lastconxresult));
-  DEBUG_WM(WM_DEBUG_DEV,F("[WIFI] reportStatus current:"),getWLStatusString(WiFi.status()));
+  DEBUG_WM(WM_DEBUG_DEV,F("[WIFI] reportStatus current:"),getWLStatusString(state.status));
   String str;
-  if (WiFi_SSID() != ""){
-    if (WiFi.status()==WL_CONNECTED){
-      str = FPSTR(HTTP_STATUS_ON);
-      str.replace(FPSTR(T_i),WiFi.localIP().toString());
-      str.replace(FPSTR(T_v),htmlEntities(WiFi_SSID()));
+  if (state.ssid != ""){
+    if (state.status==WL_CONNECTED){
+      str = WM_LS(HTTP_STATUS_ON);
+      str.replace(FPSTR(T_i),state.ip.toString());
+      str.replace(FPSTR(T_v),htmlEntities(state.ssid));
     }
     else {
-      str = FPSTR(HTTP_STATUS_OFF);
-      str.replace(FPSTR(T_v),htmlEntities(WiFi_SSID()));
+      str = WM_LS(HTTP_STATUS_OFF);
+      str.replace(FPSTR(T_v),htmlEntities(state.ssid));
       if(_lastconxresult == WL_STATION_WRONG_PASSWORD){
         // wrong password
         str.replace(FPSTR(T_c),"D"); // class
-        str.replace(FPSTR(T_r),FPSTR(HTTP_STATUS_OFFPW));
+        str.replace(FPSTR(T_r),WM_LS(HTTP_STATUS_OFFPW));
       }
       else if(_lastconxresult == WL_NO_SSID_AVAIL){
         // connect failed, or ap not found
         str.replace(FPSTR(T_c),"D");
-        str.replace(FPSTR(T_r),FPSTR(HTTP_STATUS_OFFNOAP));
+        str.replace(FPSTR(T_r),WM_LS(HTTP_STATUS_OFFNOAP));
       }
       else if(_lastconxresult == WL_CONNECT_FAILED){
         // connect failed
         str.replace(FPSTR(T_c),"D");
-        str.replace(FPSTR(T_r),FPSTR(HTTP_STATUS_OFFFAIL));
+        str.replace(FPSTR(T_r),WM_LS(HTTP_STATUS_OFFFAIL));
       }
       else if(_lastconxresult == WL_CONNECTION_LOST){
         // connect failed, MOST likely 4WAY_HANDSHAKE_TIMEOUT/incorrect password, state is ambiguous however
         str.replace(FPSTR(T_c),"D");
-        str.replace(FPSTR(T_r),FPSTR(HTTP_STATUS_OFFFAIL));
+        str.replace(FPSTR(T_r),WM_LS(HTTP_STATUS_OFFFAIL));
       }
       else{
         str.replace(FPSTR(T_c),"");
@@ -2515,7 +4079,7 @@ void WiFiManager::reportStatus(String &page){
     }
   }
   else {
-    str = FPSTR(HTTP_STATUS_NONE);
+    str = WM_LS(HTTP_STATUS_NONE);
   }
   page += str;
 }
@@ -2650,6 +4214,12 @@ void WiFiManager::resetSettings() {
     WiFi.disconnect(true);
     WiFi.persistent(false);
   #endif
+  #ifdef WM_FASTCONNECT
+    fastConnectClear();
+  #endif
+  #ifdef WM_MULTIAP
+    clearCredentials();
+  #endif
   #ifdef WM_DEBUG_LEVEL
   DEBUG_WM(F("SETTINGS ERASED"));
   #endif
@@ -2821,6 +4391,27 @@ void WiFiManager::setWebServerCallback( std::function<void()> func ) {
   _webservercallback = func;
 }
 
+/**
+ * setPortalReadyCallback, set a callback when the config portal can serve clients
+ * @since $dev
+ * @access public
+ * @param {[type]} void (*func)(void)
+ */
+void WiFiManager::setPortalReadyCallback( std::function<void()> func ) {
+  _portalreadycallback = func;
+}
+
+/**
+ * setProcessWakeCallback, set a callback fired from other tasks when process() has queued work
+ * keep it short, eg. xTaskNotifyGive the loop task
+ * @since $dev
+ * @access public
+ * @param {[type]} void (*func)(void)
+ */
+void WiFiManager::setProcessWakeCallback( std::function<void()> func ) {
+  _processwakecallback = func;
+}
+
 /**
  * setSaveConfigCallback, set a save config callback after closing configportal
  * @note calls only if wifi is saved or changed, or setBreakAfterConfig(true)
@@ -2876,6 +4467,16 @@ void WiFiManager::setPreOtaUpdateCallback( std::function<void()> func ) {
   _preotaupdatecallback = func;
 }
 
+/**
+ * setOtaProgressCallback, set a callback to fire on each OTA upload chunk and at upload end
+ * @since $dev
+ * @access public
+ * @param {[type]} void (*func)(const wm_ota_stats_t&)
+ */
+void WiFiManager::setOtaProgressCallback( std::function<void(const wm_ota_stats_t&)> func ) {
+  _otaprogresscallback = func;
+}
+
 /**
  * setConfigPortalTimeoutCallback, set a callback to config portal is timeout
  * @access public
@@ -2893,6 +4494,7 @@ void WiFiManager::setConfigPortalTimeoutCallback( std::function<void()> func ) {
  */
 void WiFiManager::setCustomHeadElement(const char* html) {
   _customHeadElement = html;
+  _rootCache = String();
 }
 
 /**
@@ -2903,6 +4505,7 @@ void WiFiManager::setCustomHeadElement(const char* html) {
  */
 void WiFiManager::setCustomMenuHTML(const char* html) {
   _customMenuHTML = html;
+  _rootCache = String();
 }
 
 /**
@@ -2927,6 +4530,24 @@ void WiFiManager::setConfigPortalBlocking(boolean shouldBlock) {
   _configPortalIsBlocking = shouldBlock;
 }
 
+#ifdef WM_PORTALTASK
+/**
+ * process the non blocking portal on its own task, takes effect on next portal start
+ * @since $dev
+ * @access public
+ * @param bool     enable
+ * @param uint8_t  core     core to pin the task to
+ * @param uint8_t  priority task priority
+ * @param uint32_t stack    task stack bytes
+ */
+void WiFiManager::setPortalTask(bool enable, uint8_t core, uint8_t priority, uint32_t stack){
+  _portalTaskEnabled  = enable;
+  _portalTaskCore     = core;
+  _portalTaskPriority = priority;
+  _portalTaskStack    = stack;
+}
+#endif
+
 /**
  * toggle restore persistent, track internally
  * sets ESP wifi.persistent so we can remember it and restore user preference on destruct
@@ -3144,6 +4765,7 @@ String WiFiManager::getWiFiHostname(){
  */
 void WiFiManager::setTitle(String title){
   _title = title;
+  _rootCache = String();
 }
 
 /**
@@ -3160,6 +4782,7 @@ void WiFiManager::setMenu(const char * menu[], uint8_t size){
   // DEBUG_WM(WM_DEBUG_DEV,"setmenu array");
   #endif
   _menuIds.clear();
+  _rootCache = String();
   for(size_t i = 0; i < size; i++){
     for(size_t j = 0; j < _nummenutokens; j++){
       if((String)menu[i] == (__FlashStringHelper *)(_menutokens[j])){
@@ -3189,6 +4812,7 @@ void WiFiManager::setMenu(std::vector<const char *>& menu){
   // DEBUG_WM(WM_DEBUG_DEV,"setmenu vector");
   #endif
   _menuIds.clear();
+  _rootCache = String();
   for(auto menuitem : menu ){
     for(size_t j = 0; j < _nummenutokens; j++){
       if((String)menuitem == (__FlashStringHelper *)(_menutokens[j])){
@@ -3198,46 +4822,193 @@ void WiFiManager::setMenu(std::vector<const char *>& menu){
     }
   }
   #ifdef WM_DEBUG_LEVEL
-  // DEBUG_WM(WM_DEBUG_DEV,getMenuOut());
+  // DEBUG_WM(WM_DEBUG_DEV,getMenuOut());
+  #endif
+}
+
+
+/**
+ * set params as sperate page not in wifi
+ * NOT COMPATIBLE WITH setMenu! 
+ * @todo scan menuids and insert param after wifi or something, same for ota
+ * @param bool enable 
+ * @since $dev
+ */
+void WiFiManager::setParamsPage(bool enable){
+  _paramsInWifi  = !enable;
+  setMenu(enable ? _menuIdsParams : _menuIdsDefault);
+}
+
+// GETTERS
+
+/**
+ * get config portal AP SSID
+ * @since 0.0.1
+ * @access public
+ * @return String the configportal ap name
+ */
+String WiFiManager::getConfigPortalSSID() {
+  return _apName;
+}
+
+/**
+ * return the last known connection result
+ * logged on autoconnect and wifisave, can be used to check why failed
+ * get as readable string with getWLStatusString(getLastConxResult);
+ * @since $dev
+ * @access public
+ * @return bool return wl_status codes
+ */
+uint8_t WiFiManager::getLastConxResult(){
+  return _lastconxresult;
+}
+
+/**
+ * return ms from connect start to connected (ip) of the last successful connect
+ * @since $dev
+ * @access public
+ * @return unsigned long ms, 0 if never connected
+ */
+unsigned long WiFiManager::getLastConxTime(){
+  return _lastconxtime;
+}
+
+/**
+ * return ms from startConfigPortal to the portal being reachable, of the last config portal
+ * @since $dev
+ * @access public
+ * @return unsigned long ms, 0 if no config portal was started
+ */
+unsigned long WiFiManager::getPortalReadyTime(){
+  return _portalReadyTime;
+}
+
+#ifdef WM_ROAMING
+/**
+ * enable background roaming between bssids of the connected ssid
+ * @since $dev
+ * @access public
+ * @param bool    enable
+ * @param int8_t  threshold  dBm averaged rssi below which to look for a better ap
+ * @param uint8_t hysteresis dB a candidate must be stronger than the current ap
+ */
+void WiFiManager::setRoaming(bool enable, int8_t threshold, uint8_t hysteresis){
+  _roaming        = enable;
+  _roamThreshold  = threshold;
+  _roamHysteresis = hysteresis;
+}
+
+/**
+ * setRoamCallback, set a callback to fire after each roam attempt, with timing
+ * @since $dev
+ * @access public
+ * @param {[type]} void (*func)(const wm_roam_event_t&)
+ */
+void WiFiManager::setRoamCallback( std::function<void(const wm_roam_event_t&)> func ) {
+  _roamcallback = func;
+}
+#endif
+
+#ifdef WM_POWERSAVE
+/**
+ * set the station power save mode, applied now and kept by the core across mode changes
+ * @since $dev
+ * @access public
+ * @param wifi_ps_type_t mode WIFI_PS_NONE, WIFI_PS_MIN_MODEM or WIFI_PS_MAX_MODEM
+ * @param uint8_t        dtim ap dtim period in beacons
+ */
+void WiFiManager::setPowerSave(wifi_ps_type_t mode, uint8_t dtim){
+  _powerSave = mode;
+  _psDtim    = dtim ? dtim : 1;
+  powerSaveApply();
+}
+
+/**
+ * ms between radio wakeups while connected
+ * @since $dev
+ * @access public
+ * @return unsigned long ms, 0 if power save is off, suspended or not connected
+ */
+unsigned long WiFiManager::getPowerSaveInterval(){
+  if(_psSuspended || !WiFi.isConnected()) return 0;
+  if(_powerSave == WIFI_PS_MIN_MODEM) return (unsigned long)_psDtim * WM_PS_BEACON_US / 1000;
+  if(_powerSave == WIFI_PS_MAX_MODEM) return (unsigned long)WM_PS_LISTEN_INTERVAL * WM_PS_BEACON_US / 1000;
+  return 0;
+}
+
+/**
+ * round up to a whole number of radio wakeups
+ * @since $dev
+ * @access public
+ * @param  unsigned long ms
+ * @return unsigned long ms, unchanged if the radio is not sleeping
+ */
+unsigned long WiFiManager::alignToPowerSave(unsigned long ms){
+  unsigned long interval = getPowerSaveInterval();
+  if(!interval) return ms;
+  return (ms + interval - 1) / interval * interval;
+}
+
+// set the effective mode, the core stores it and re-applies it when the station starts
+void WiFiManager::powerSaveApply(){
+  wifi_ps_type_t mode = _psSuspended ? WIFI_PS_NONE : _powerSave;
+  if(WiFi.getSleep() == mode) return;
+  WiFi.setSleep(mode);
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(WM_DEBUG_VERBOSE,F("power save:"),(int)mode);
   #endif
 }
+#endif
 
-
+#ifdef WM_MULTIAP
 /**
- * set params as sperate page not in wifi
- * NOT COMPATIBLE WITH setMenu! 
- * @todo scan menuids and insert param after wifi or something, same for ota
- * @param bool enable 
+ * remember a network for multi ap connect
  * @since $dev
+ * @access public
+ * @param  char* ssid
+ * @param  char* pass
+ * @return bool false if ssid or pass too long
  */
-void WiFiManager::setParamsPage(bool enable){
-  _paramsInWifi  = !enable;
-  setMenu(enable ? _menuIdsParams : _menuIdsDefault);
+bool WiFiManager::addCredential(const char *ssid, const char *pass){
+  return credentialStore(String(ssid), String(pass));
 }
 
-// GETTERS
+/**
+ * forget all remembered networks
+ * @since $dev
+ * @access public
+ */
+void WiFiManager::clearCredentials(){
+  Preferences prefs;
+  if(prefs.begin("wmcreds", false)){
+    prefs.clear();
+    prefs.end();
+  }
+}
+#endif
 
+#ifdef WM_FASTCONNECT
 /**
- * get config portal AP SSID
- * @since 0.0.1
+ * enable fast connect, cache bssid/channel of good connections and use them on the next connect
+ * @since $dev
  * @access public
- * @return String the configportal ap name
+ * @param bool enable
+ * @param bool cacheip also reuse the ip lease, skips dhcp
  */
-String WiFiManager::getConfigPortalSSID() {
-  return _apName;
+void WiFiManager::setFastConnect(bool enable, bool cacheip){
+  _fastConnect   = enable;
+  _fastConnectIP = cacheip;
 }
 
 /**
- * return the last known connection result
- * logged on autoconnect and wifisave, can be used to check why failed
- * get as readable string with getWLStatusString(getLastConxResult);
  * @since $dev
  * @access public
- * @return bool return wl_status codes
+ * @return bool last successful connect used the fast connect cache
  */
-uint8_t WiFiManager::getLastConxResult(){
-  return _lastconxresult;
+bool WiFiManager::getFastConnected(){
+  return _fastConnected;
 }
+#endif
 
 /**
  * check if wifi has a saved ap or not
@@ -3277,6 +5048,7 @@ void WiFiManager::setCountry(String cc){
  */
 void WiFiManager::setClass(String str){
   _bodyClass = str;
+  _rootCache = String();
 }
 
 /**
@@ -3285,6 +5057,7 @@ void WiFiManager::setClass(String str){
  */
 void WiFiManager::setDarkMode(bool enable){
   _bodyClass = enable ? "invert" : "";
+  _rootCache = String();
 }
 
 /**
@@ -3302,6 +5075,222 @@ bool WiFiManager::preloadWiFi(String ssid, String pass){
   return true;
 }
 
+#ifdef WM_LANGPACK
+/**
+ * add a language pack
+ * pack files are built from a strings file with extras/langpack.js
+ * and can be stored on any FS (SPIFFS, LittleFS, FFat partition)
+ * @since $dev
+ * @access public
+ * @param  fs::FS &fs  filesystem pack is stored on, must be mounted
+ * @param  char* path  pack file path, eg. /wm_es.bin
+ * @return bool        false if pack is missing or invalid
+ */
+bool WiFiManager::addLanguagePack(fs::FS &fs, const char *path){
+  fs::File f = fs.open(path, "r");
+  if(!f){
+    #ifdef WM_DEBUG_LEVEL
+    DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] language pack not found:"),path);
+    #endif
+    return false;
+  }
+
+  // header, magic[4] version[1] reserved[1] count[2] lang[8]
+  uint8_t header[16];
+  bool ret = f.read(header, sizeof(header)) == sizeof(header) && memcmp_P(header, WM_LANGPACK_MAGIC, 4) == 0 && header[4] == WM_LANGPACK_VERSION;
+  f.close();
+
+  if(!ret || _langpacks.size() >= INT8_MAX){
+    #ifdef WM_DEBUG_LEVEL
+    DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] language pack invalid:"),path);
+    #endif
+    return false;
+  }
+
+  char lang[9];
+  memcpy(lang, header + 8, 8);
+  lang[8] = 0;
+  _langpacks.emplace_back();
+  wm_langpack_t &pack = _langpacks.back();
+  pack.fs   = &fs;
+  pack.path = path;
+  pack.lang = lang;
+  for(uint8_t i = 0; i < WM_LANGPACK_CACHE; i++) pack.cacheId[i] = WM_LP_MAX;
+
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(WM_DEBUG_VERBOSE,F("Added language pack:"),lang);
+  #endif
+  return true;
+}
+
+/**
+ * pick a language pack from an Accept-Language header, eg. "es-ES,es;q=0.9,en;q=0.8"
+ * languages are tried in header order, exact tag first then primary subtag
+ * @since $dev
+ * @param  String acceptlang header value
+ * @return int8_t _langpacks index, -1 for compiled strings
+ */
+int8_t WiFiManager::selectLanguagePack(const String &acceptlang){
+  if(_langpacks.empty() || acceptlang == "") return -1;
+
+  int start = 0;
+  while(start < (int)acceptlang.length()){
+    int end = acceptlang.indexOf(',', start);
+    if(end < 0) end = acceptlang.length();
+    String tag = acceptlang.substring(start, end);
+    int q = tag.indexOf(';');
+    if(q >= 0) tag = tag.substring(0, q);
+    tag.trim();
+    start = end + 1;
+    if(tag == "" || tag == "*") continue;
+
+    // the compiled strings win if they match before any pack does
+    if(tag.equalsIgnoreCase(FPSTR(WM_LANGUAGE))) return -1;
+
+    int dash = tag.indexOf('-');
+    String primary = dash > 0 ? tag.substring(0, dash) : tag;
+    int8_t partial = -1;
+    for(size_t i = 0; i < _langpacks.size(); i++){
+      const String &lang = _langpacks[i].lang;
+      if(lang.equalsIgnoreCase(tag)) return i;
+      if(partial < 0 && (lang.equalsIgnoreCase(primary) || (lang.length() > primary.length() && lang.charAt(primary.length()) == '-' && lang.substring(0, primary.length()).equalsIgnoreCase(primary)))) partial = i;
+    }
+    if(partial >= 0) return partial;
+    if(String(FPSTR(WM_LANGUAGE)).startsWith(primary)) return -1;
+  }
+  return -1;
+}
+
+/**
+ * open a language pack file for string reads, its index is read and checked on first use
+ * a pack that fails the checks is treated as missing, its strings fall back to the compiled ones
+ * @since $dev
+ * @param  int8_t idx _langpacks index
+ * @return bool success
+ */
+bool WiFiManager::loadLanguagePack(int8_t idx){
+  if(idx == _langpackLoaded) return _langpackLoaded >= 0;
+  if(_langpackFile) _langpackFile.close();
+  _langpackLoaded = -1;
+  if(idx < 0 || idx >= (int8_t)_langpacks.size()) return false;
+
+  wm_langpack_t &pack = _langpacks[idx];
+  _langpackFile = pack.fs->open(pack.path, "r");
+  if(!_langpackFile){
+    #ifdef WM_DEBUG_LEVEL
+    DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] language pack read failed:"),pack.path);
+    #endif
+    return false;
+  }
+  if(pack.index.empty() && !loadLanguagePackIndex(pack)){
+    #ifdef WM_DEBUG_LEVEL
+    DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] language pack invalid:"),pack.path);
+    #endif
+    _langpackFile.close();
+    return false;
+  }
+
+  _langpackLoaded = idx;
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(WM_DEBUG_DEV,F("Loaded language pack:"),pack.lang);
+  #endif
+  return true;
+}
+
+/**
+ * read the index of the open pack file into pack.index
+ * the file may have been replaced since addLanguagePack, header, index size, order and string ranges are all checked
+ * @since $dev
+ * @param  wm_langpack_t &pack
+ * @return bool false and an empty index if the file is not a valid pack
+ */
+bool WiFiManager::loadLanguagePackIndex(wm_langpack_t &pack){
+  // header, magic[4] version[1] reserved[1] count[2] lang[8]
+  uint8_t header[16];
+  size_t  size = _langpackFile.size();
+  if(_langpackFile.read(header, sizeof(header)) != sizeof(header)) return false;
+  if(memcmp_P(header, WM_LANGPACK_MAGIC, 4) != 0 || header[4] != WM_LANGPACK_VERSION) return false;
+
+  uint16_t count = header[6] | (header[7] << 8);
+  size_t   bytes = count * sizeof(wm_langpack_entry_t);
+  if(count == 0 || bytes > size - sizeof(header)) return false; // also keeps a bogus count from a huge allocation
+
+  pack.index.resize(count);
+  bool ret = _langpackFile.read((uint8_t*)pack.index.data(), bytes) == bytes;
+
+  // strictly increasing ids for lower_bound, strings after the index and inside the file
+  size_t data = sizeof(header) + bytes;
+  for(uint16_t i = 0; ret && i < count; i++){
+    const wm_langpack_entry_t &e = pack.index[i];
+    ret = e.id < WM_LP_MAX && (i == 0 || e.id > pack.index[i-1].id)
+       && e.offset >= data && e.offset <= size && e.len <= size - e.offset;
+  }
+
+  if(!ret){
+    pack.index.clear();
+    pack.index.shrink_to_fit();
+  }
+  return ret;
+}
+
+/**
+ * close the pack file and free all pack indexes and cached strings, packs stay registered
+ * @since $dev
+ */
+void WiFiManager::unloadLanguagePack(){
+  if(_langpackFile) _langpackFile.close();
+  for(wm_langpack_t &pack : _langpacks){
+    pack.index.clear();
+    pack.index.shrink_to_fit();
+    for(uint8_t i = 0; i < WM_LANGPACK_CACHE; i++){
+      pack.cache[i]   = String();
+      pack.cacheId[i] = WM_LP_MAX;
+    }
+  }
+  _langpackLoaded = -1;
+}
+
+/**
+ * get a render string for the language selected by the current request
+ * short strings are cached per pack, the rest are read from the open pack file
+ * @since $dev
+ * @param  uint16_t id        wm_langtoken_t
+ * @param  fallback           compiled string used if no pack selected or id missing from pack
+ * @return String
+ */
+String WiFiManager::getLangString(uint16_t id, const __FlashStringHelper *fallback){
+  if(_langpackSelected < 0) return fallback;
+
+  wm_langpack_t &pack = _langpacks[_langpackSelected];
+  uint8_t slot = id % WM_LANGPACK_CACHE;
+  if(pack.cacheId[slot] == id) return pack.cache[slot];
+
+  if(!loadLanguagePack(_langpackSelected)) return fallback;
+
+  // index is sorted by id, packs may omit untranslated ids
+  auto it = std::lower_bound(pack.index.begin(), pack.index.end(), id,
+    [](const wm_langpack_entry_t &e, uint16_t v){ return e.id < v; });
+  if(it == pack.index.end() || it->id != id) return fallback;
+
+  String str;
+  if(!str.reserve(it->len) || !_langpackFile.seek(it->offset)) return fallback;
+  char buf[64];
+  size_t remaining = it->len;
+  while(remaining > 0){
+    size_t n = _langpackFile.read((uint8_t*)buf, remaining < sizeof(buf) ? remaining : sizeof(buf));
+    if(n == 0) return fallback;
+    str.concat(buf, n);
+    remaining -= n;
+  }
+
+  if(it->len <= WM_LANGPACK_CACHE_LEN){
+    pack.cache[slot]   = str;
+    pack.cacheId[slot] = id;
+  }
+  return str;
+}
+#endif
+
 // HELPERS
 
 /**
@@ -3327,24 +5316,30 @@ String WiFiManager::getWiFiPass(bool persistent){
 // DEBUG
 // @todo fix DEBUG_WM(0,0);
 template <typename Generic>
-void WiFiManager::DEBUG_WM(Generic text) {
-  DEBUG_WM(WM_DEBUG_NOTIFY,text,"");
+void WiFiManager::debugWM(Generic text) {
+  debugWM(WM_DEBUG_NOTIFY,text,"");
 }
 
 template <typename Generic>
-void WiFiManager::DEBUG_WM(wm_debuglevel_t level,Generic text) {
-  if(_debugLevel >= level) DEBUG_WM(level,text,"");
+void WiFiManager::debugWM(wm_debuglevel_t level,Generic text) {
+  if(_debugLevel >= level) debugWM(level,text,"");
 }
 
 template <typename Generic, typename Genericb>
-void WiFiManager::DEBUG_WM(Generic text,Genericb textb) {
-  DEBUG_WM(WM_DEBUG_NOTIFY,text,textb);
+void WiFiManager::debugWM(Generic text,Genericb textb) {
+  debugWM(WM_DEBUG_NOTIFY,text,textb);
 }
 
 template <typename Generic, typename Genericb>
-void WiFiManager::DEBUG_WM(wm_debuglevel_t level,Generic text,Genericb textb) {
+void WiFiManager::debugWM(wm_debuglevel_t level,Generic text,Genericb textb) {
   if(!_debug || _debugLevel < level) return;
 
+  #ifdef WM_DEBUG_DEFERRED
+  WiFiManagerDebugLine out; // formatted on the caller's stack, queued below
+  #else
+  Print &out = _debugPort;
+  #endif
+
   if(_debugLevel >= WM_DEBUG_MAX){
     #ifdef ESP8266
     // uint32_t free;
@@ -3365,19 +5360,92 @@ void WiFiManager::DEBUG_WM(wm_debuglevel_t level,Generic text,Genericb textb) {
     uint32_t free = info.total_free_bytes;
     uint16_t max  = info.largest_free_block;
     uint8_t frag = 100 - (max * 100) / free;
-    _debugPort.printf("[MEM] free: %5d | max: %5d | frag: %3d%% \n", free, max, frag);    
+    out.printf("[MEM] free: %5d | max: %5d | frag: %3d%% \n", free, max, frag);    
     #endif
   }
 
-  _debugPort.print(_debugPrefix);
-  if(_debugLevel >= debugLvlShow) _debugPort.print("["+(String)level+"] ");
-  _debugPort.print(text);
+  out.print(_debugPrefix);
+  if(_debugLevel >= debugLvlShow){
+    out.print('[');
+    out.print((uint8_t)level);
+    out.print(F("] "));
+  }
+  out.print(text);
   if(textb){
-    _debugPort.print(" ");
-    _debugPort.print(textb);
+    out.print(" ");
+    out.print(textb);
+  }
+  #ifdef WM_DEBUG_DEFERRED
+  out.buf[out.len++] = '\n';
+  debugPush(out.buf, out.len);
+  #else
+  out.println();
+  #endif
+}
+
+#ifdef WM_DEBUG_DEFERRED
+/**
+ * queue a formatted debug line, drops the line if the ring is full, never waits on the debug port
+ * @param const char* line
+ * @param size_t      len
+ */
+void WiFiManager::debugPush(const char *line, size_t len){
+  #ifdef ESP32
+  portENTER_CRITICAL(&_debugMux);
+  #endif
+  uint32_t head = _debugHead.load(std::memory_order_relaxed);
+  if(len > WM_DEBUG_RINGSIZE - (head - _debugTail.load(std::memory_order_acquire))){
+    _debugDropped++;
+  }
+  else {
+    for(size_t i = 0; i < len; i++) _debugRing[(head + i) & (WM_DEBUG_RINGSIZE - 1)] = line[i];
+    _debugHead.store(head + len, std::memory_order_release);
+  }
+  #ifdef ESP32
+  portEXIT_CRITICAL(&_debugMux);
+  #endif
+}
+
+/**
+ * write queued debug output, called from process()
+ * only writes what the port can take without blocking, when the port reports it
+ */
+void WiFiManager::debugFlush(){
+  uint32_t tail  = _debugTail.load(std::memory_order_relaxed);
+  uint32_t avail = _debugHead.load(std::memory_order_acquire) - tail;
+  if(!avail) return;
+
+  int room = _debugPort.availableForWrite();
+  if(room <= 0) room = 64; // port does not report, small bounded write
+  if(avail > (uint32_t)room) avail = room;
+
+  while(avail){
+    uint32_t pos = tail & (WM_DEBUG_RINGSIZE - 1);
+    uint32_t n   = WM_DEBUG_RINGSIZE - pos; // up to ring end
+    if(n > avail) n = avail;
+    _debugPort.write((const uint8_t*)_debugRing + pos, n);
+    tail  += n;
+    avail -= n;
+  }
+  _debugTail.store(tail, std::memory_order_release);
+
+  if(_debugHead.load(std::memory_order_acquire) != tail) return;
+  // loggers count drops under the mux, read and clear it there so none are lost
+  #ifdef ESP32
+  portENTER_CRITICAL(&_debugMux);
+  #endif
+  uint32_t dropped = _debugDropped;
+  _debugDropped = 0;
+  #ifdef ESP32
+  portEXIT_CRITICAL(&_debugMux);
+  #endif
+  if(dropped){
+    _debugPort.print(_debugPrefix);
+    _debugPort.print(F("[dropped lines] "));
+    _debugPort.println(dropped);
   }
-  _debugPort.println();
 }
+#endif
 
 /**
  * [debugSoftAPConfig description]
@@ -3525,6 +5593,20 @@ String WiFiManager::htmlEntities(String str, bool whitespace) {
 return str;
 }
 
+/**
+ * escape a string for use as a json string value
+ * @param  String str
+ * @return String
+ */
+String WiFiManager::jsonEscape(String str) {
+  str.replace("\\","\\\\");
+  str.replace("\"","\\\"");
+  str.replace("\n","\\n");
+  str.replace("\r","\\r");
+  str.replace("\t","\\t");
+  return str;
+}
+
 /**
  * [getWLStatusString description]
  * @access public
@@ -3665,6 +5747,42 @@ bool WiFiManager::WiFi_Disconnect() {
     return false;
 }
 
+/**
+ * drop a bssid and channel pinned by WiFi.begin(ssid, pass, channel, bssid) from the sta config, the link is not touched
+ * the driver's reconnects and a later WiFi.begin() can then use any ap of the network on any channel
+ * @since $dev
+ * @return bool success
+ */
+bool WiFiManager::WiFi_unpinSTA() {
+    #ifdef ESP8266
+      struct station_config conf;
+      if(!wifi_station_get_config(&conf)) return false;
+      if(!conf.bssid_set) return true;
+      conf.bssid_set = 0;
+      return wifi_station_set_config_current(&conf);
+    #elif defined(ESP32)
+      wifi_config_t conf;
+      if(esp_wifi_get_config(WIFI_IF_STA, &conf) != ESP_OK) return false;
+      if(!conf.sta.bssid_set && conf.sta.channel == 0) return true;
+      conf.sta.bssid_set = 0;
+      conf.sta.channel   = 0;
+      return esp_wifi_set_config(WIFI_IF_STA, &conf) == ESP_OK;
+    #endif
+    return false;
+}
+
+#ifdef ESP32
+/**
+ * esp32 sta config storage, ram while trying networks that must not replace the one saved in nvs
+ * the driver has no getter, restoring goes back to the mode the core set up at init, known from _userpersistent like _end()
+ * @since $dev
+ * @param bool ram true WIFI_STORAGE_RAM, false restore
+ */
+void WiFiManager::WiFi_storageRAM(bool ram) {
+    esp_wifi_set_storage(ram || !_userpersistent ? WIFI_STORAGE_RAM : WIFI_STORAGE_FLASH);
+}
+#endif
+
 // toggle STA without persistent
 bool WiFiManager::WiFi_enableSTA(bool enable,bool persistent) {
 #ifdef WM_DEBUG_LEVEL
@@ -3813,6 +5931,7 @@ String WiFiManager::WiFi_psk(bool persistent) const {
     #define ARDUINO_EVENT_WIFI_STA_DISCONNECTED SYSTEM_EVENT_STA_DISCONNECTED
     #define ARDUINO_EVENT_WIFI_SCAN_DONE SYSTEM_EVENT_SCAN_DONE
   #endif
+    if(event != ARDUINO_EVENT_WIFI_SCAN_DONE) _wifiStateDirty = true; // sta connect, disconnect, ip and config changes
     if(!_hasBegun){
       #ifdef WM_DEBUG_LEVEL
         // DEBUG_WM(WM_DEBUG_VERBOSE,"[ERROR] WiFiEvent, not ready");
@@ -3826,6 +5945,15 @@ String WiFiManager::WiFi_psk(bool persistent) const {
     // DEBUG_WM(WM_DEBUG_VERBOSE,"[EVENT]",event);
     #endif
     if(event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED){
+      #ifdef WM_METRICS
+      _staDisconnects++;
+      #endif
+      #ifdef WM_ROAMING
+      if(_roamState == 2) _roamLeft = true; // may reconnect before the next roamProcess() sees the status drop
+      #endif
+      #ifdef WM_EVENTLOG
+      logEvent(WM_EV_STA_DISCONNECT, info.wifi_sta_disconnected.reason);
+      #endif
     #ifdef WM_DEBUG_LEVEL
       DEBUG_WM(WM_DEBUG_VERBOSE,F("[EVENT] WIFI_REASON: "),info.wifi_sta_disconnected.reason);
       #endif
@@ -3877,33 +6005,46 @@ void WiFiManager::handleUpdate() {
 	String page = getHTTPHead(_title); // @token options
 	String str = FPSTR(HTTP_ROOT_MAIN);
   str.replace(FPSTR(T_t), _title);
-	str.replace(FPSTR(T_v), configPortalActive ? _apName : (getWiFiHostname() + " - " + WiFi.localIP().toString())); // use ip if ap is not active for heading
+	str.replace(FPSTR(T_v), configPortalActive ? _apName : (getWiFiHostname() + " - " + getWiFiState().ip.toString())); // use ip if ap is not active for heading
 	page += str;
 
-	page += FPSTR(HTTP_UPDATE);
+	page += WM_LS(HTTP_UPDATE);
 	page += FPSTR(HTTP_END);
 
 	HTTPSend(page);
 
 }
 
-// upload via /u POST
+// parse a hex digest, eg. sha256 from the upload url
+static bool hexToBytes(const String &hex, uint8_t *out, size_t len){
+  if(hex.length() != len * 2) return false;
+  for(size_t i = 0; i < len * 2; i++){
+    char c = hex.charAt(i);
+    uint8_t v;
+    if(c >= '0' && c <= '9') v = c - '0';
+    else if(c >= 'a' && c <= 'f') v = c - 'a' + 10;
+    else if(c >= 'A' && c <= 'F') v = c - 'A' + 10;
+    else return false;
+    if(i % 2 == 0) out[i / 2] = v << 4;
+    else out[i / 2] |= v;
+  }
+  return true;
+}
+
+// upload via /u POST, optional /u?sha256=<hex> to verify the image before it is activated
 void WiFiManager::handleUpdating(){
   // @todo
   // cannot upload files in captive portal, file select is not allowed, show message with link or hide
   // cannot upload if softreset after upload, maybe check for hard reset at least for dev, ERROR[11]: Invalid bootstrapping state, reset ESP8266 before updating
   // add upload status to webpage somehow
-  // abort upload if error detected ?
+  // [x] abort upload if error detected ?
   // [x] supress cp timeout on upload, so it doesnt keep uploading?
-  // add progress handler for debugging
+  // [x] add progress handler for debugging
   // combine route handlers into one callback and use argument or post checking instead of mutiple functions maybe, if POST process else server upload page?
   // [x] add upload checking, do we need too check file?
   // convert output to debugger if not moving to example
 	
   // if (captivePortal()) return; // If captive portal redirect instead of displaying the page
-  bool error = false;
-  unsigned long _configPortalTimeoutSAV = _configPortalTimeout; // store cp timeout
-  _configPortalTimeout = 0; // disable timeout
 
   // handler for the file upload, get's the sketch bytes, and writes
 	// them through the Update object
@@ -3913,6 +6054,20 @@ void WiFiManager::handleUpdating(){
 	if (upload.status == UPLOAD_FILE_START) {
 	  // if(_debug) Serial.setDebugOutput(true);
     uint32_t maxSketchSpace;
+    _otaTimeoutSAV = _configPortalTimeout; // store cp timeout
+    _configPortalTimeout = 0; // disable timeout
+    _otaError = false;
+    _otaHashMismatch = false;
+    _otaFailReason = nullptr;
+    _otaStats = {};
+    _otaStart = _otaLastChunk = micros();
+    #ifdef WM_EVENTLOG
+    logEvent(WM_EV_OTA_START);
+    #endif
+    #ifdef WM_OTA_INFLATE
+    otaInflateEnd(); // previous upload may not have ended
+    _otaFormat = 0;
+    #endif
     
     // Use new callback for before OTA update
     if (_preotaupdatecallback != NULL) {
@@ -3932,33 +6087,93 @@ void WiFiManager::handleUpdating(){
     DEBUG_WM(WM_DEBUG_VERBOSE,"[OTA] Update file: ", upload.filename.c_str());
     #endif
 
-    // Update.onProgress(THandlerFunction_Progress fn);
-    // Update.onProgress([](unsigned int progress, unsigned int total) {
-    //       Serial.printf("Progress: %u%%\r", (progress / (total / 100)));
-    // });
+    // url args are parsed before the multipart body, so the digest is known before the first chunk
+    String digest = server->arg(F("sha256"));
+    _otaVerify = digest != "";
+    if(_otaVerify && !hexToBytes(digest, _otaDigest, sizeof(_otaDigest))){
+      #ifdef WM_DEBUG_LEVEL
+      DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] OTA invalid sha256"), digest);
+      #endif
+      _otaFailReason = F("invalid sha256 argument");
+      _otaError = true;
+    }
+
+    #ifdef ESP32
+      mbedtls_sha256_init(&_otaSha);
+      mbedtls_sha256_starts(&_otaSha, 0);
+    #else
+      br_sha256_init(&_otaSha);
+    #endif
 
-  	if (!Update.begin(maxSketchSpace)) { // start with max available size
+  	if (!_otaError && !Update.begin(maxSketchSpace)) { // start with max available size
         #ifdef WM_DEBUG_LEVEL
         DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] OTA Update ERROR"), Update.getError());
         #endif
-        error = true;
+        _otaError = true;
         Update.end(); // Not sure the best way to abort, I think client will keep sending..
   	}
 	}
   // UPLOAD WRITE
   else if (upload.status == UPLOAD_FILE_WRITE) {
-		// Serial.print(".");
-		if (Update.write(upload.buf, upload.currentSize) != upload.currentSize) {
-      #ifdef WM_DEBUG_LEVEL
-      DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] OTA Update WRITE ERROR"), Update.getError());
-			//Update.printError(Serial); // write failure
-      #endif
-      error = true;
+    if(_otaError) return; // client keeps sending after a failure, drop the rest
+
+    unsigned long now = micros();
+    uint32_t gap = now - _otaLastChunk;
+    if(gap > _otaStats.chunkMaxUs) _otaStats.chunkMaxUs = gap;
+
+    #ifdef ESP32
+      mbedtls_sha256_update(&_otaSha, upload.buf, upload.currentSize);
+    #else
+      br_sha256_update(&_otaSha, upload.buf, upload.currentSize);
+    #endif
+
+		if (!otaWrite(upload.buf, upload.currentSize)) {
+      _otaError = true;
 		}
+    _otaStats.chunks++;
+    otaProgress();
+    _otaLastChunk = micros();
 	}
   // UPLOAD FILE END
   else if (upload.status == UPLOAD_FILE_END) {
-		if (Update.end(true)) { // true to set the size to the current progress
+    uint8_t hash[32];
+    #ifdef ESP32
+      mbedtls_sha256_finish(&_otaSha, hash);
+      mbedtls_sha256_free(&_otaSha);
+    #else
+      br_sha256_out(&_otaSha, hash);
+    #endif
+
+    #ifdef WM_OTA_INFLATE
+    if(!_otaError && _otaInflate && _otaInflateStatus != TINFL_STATUS_DONE){
+      #ifdef WM_DEBUG_LEVEL
+      DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] OTA compressed image truncated"));
+      #endif
+      _otaFailReason = F("compressed image truncated");
+      _otaError = true;
+    }
+    otaInflateEnd();
+    #endif
+
+    if(_otaError){
+      // already failed
+      Update.end(); // not finished, errors out without activating
+    }
+    else if(_otaVerify && memcmp(hash, _otaDigest, sizeof(hash)) != 0){
+      // do not activate the new image
+      #ifdef WM_DEBUG_LEVEL
+      DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] OTA sha256 mismatch, update aborted"));
+      #endif
+      #ifdef ESP32
+        Update.abort();
+      #else
+        Update.end(false); // not finished, errors out without activating
+      #endif
+      _otaHashMismatch = true;
+      _otaFailReason = F("SHA-256 mismatch");
+      _otaError = true;
+    }
+		else if (Update.end(true)) { // true to set the size to the current progress
       #ifdef WM_DEBUG_LEVEL
       DEBUG_WM(WM_DEBUG_VERBOSE,F("\n\n[OTA] OTA FILE END bytes: "), upload.totalSize);
 			// Serial.printf("Updated: %u bytes\r\nRebooting...\r\n", upload.totalSize);
@@ -3966,41 +6181,196 @@ void WiFiManager::handleUpdating(){
 		}
     else {
 			// Update.printError(Serial);
-      error = true;
+      _otaError = true;
 		}
+    _otaStats.done = true;
+    otaProgress();
 	}
   // UPLOAD ABORT
   else if (upload.status == UPLOAD_FILE_ABORTED) {
 		Update.end();
+    #ifdef ESP32
+      mbedtls_sha256_free(&_otaSha); // set up on file start, finish never runs
+    #endif
+    #ifdef WM_OTA_INFLATE
+    otaInflateEnd();
+    #endif
 		DEBUG_WM(F("[OTA] Update was aborted"));
-    error = true;
+    if(!_otaFailReason) _otaFailReason = F("upload aborted"); // keep an earlier reason, the client may leave after it
+    _otaError = true;
+    _otaStats.done = true;
+    otaProgress();
   }
-  if(error) _configPortalTimeout = _configPortalTimeoutSAV;
+  if(_otaError) _configPortalTimeout = _otaTimeoutSAV;
 	delay(0);
 }
 
+/**
+ * write an upload chunk, compressed images are inflated first when WM_OTA_INFLATE
+ * @param  uint8_t* data chunk
+ * @param  size_t   len
+ * @return bool     success
+ */
+bool WiFiManager::otaWrite(uint8_t *data, size_t len){
+  #ifdef WM_OTA_INFLATE
+  if(_otaFormat == 0){
+    size_t skip = 0;
+    if(!otaInflateBegin(data, len, skip)) return false;
+    data += skip;
+    len  -= skip;
+  }
+  if(_otaFormat == 2){
+    // stream through the dict window, flash each block as tinfl produces it
+    while(len > 0 || _otaInflateStatus == TINFL_STATUS_HAS_MORE_OUTPUT){
+      if(_otaInflateStatus == TINFL_STATUS_DONE) break; // gzip trailer
+      size_t in  = len;
+      size_t out = TINFL_LZ_DICT_SIZE - _otaDictOfs;
+      _otaInflateStatus = tinfl_decompress(_otaInflate, data, &in, _otaDict, _otaDict + _otaDictOfs, &out, _otaInflateFlags | TINFL_FLAG_HAS_MORE_INPUT);
+      data += in;
+      len  -= in;
+      if(out && !otaFlashWrite(_otaDict + _otaDictOfs, out)) return false;
+      _otaDictOfs = (_otaDictOfs + out) & (TINFL_LZ_DICT_SIZE - 1);
+      if(_otaInflateStatus < 0){
+        #ifdef WM_DEBUG_LEVEL
+        DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] OTA inflate failed"), _otaInflateStatus);
+        #endif
+        _otaFailReason = F("compressed image corrupt");
+        return false;
+      }
+    }
+    return true;
+  }
+  #endif
+  return otaFlashWrite(data, len);
+}
+
+// timed Update.write for ota stats
+bool WiFiManager::otaFlashWrite(uint8_t *data, size_t len){
+  unsigned long now = micros();
+  size_t written = Update.write(data, len);
+  uint32_t wt = micros() - now;
+  if(wt > _otaStats.writeMaxUs) _otaStats.writeMaxUs = wt;
+  if(wt > WM_OTA_STALL_US) _otaStats.stalls++;
+  _otaStats.bytes += written;
+
+  if (written != len) {
+    #ifdef WM_DEBUG_LEVEL
+    DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] OTA Update WRITE ERROR"), Update.getError());
+    //Update.printError(Serial); // write failure
+    #endif
+    return false;
+  }
+  return true;
+}
+
+#ifdef WM_OTA_INFLATE
+/**
+ * detect image format from the first chunk, start inflate for gzip (rfc1952) or zlib (rfc1950) uploads
+ * @param  data first chunk
+ * @param  len
+ * @param  skip set to header bytes to skip
+ * @return bool false if header is invalid or out of memory
+ */
+bool WiFiManager::otaInflateBegin(const uint8_t *data, size_t len, size_t &skip){
+  skip = 0;
+  if(len >= 10 && data[0] == 0x1f && data[1] == 0x8b && data[2] == 8){
+    // gzip, header must fit in the first chunk, deflate stream follows
+    uint8_t flg = data[3];
+    size_t p = 10;
+    if(flg & 0x04) p = p + 2 > len ? len + 1 : p + 2 + (data[p] | (data[p+1] << 8)); // FEXTRA
+    if(flg & 0x08) while(p < len && data[p++]);  // FNAME
+    if(flg & 0x10) while(p < len && data[p++]);  // FCOMMENT
+    if(flg & 0x02) p += 2;                       // FHCRC
+    if(p > len){
+      _otaFailReason = F("invalid gzip header");
+      return false;
+    }
+    skip = p;
+    _otaInflateFlags = 0;
+  }
+  else if(len >= 2 && (data[0] & 0x0f) == 8 && ((data[0] << 8) | data[1]) % 31 == 0){
+    // zlib, esp image magic 0xE9 never matches
+    _otaInflateFlags = TINFL_FLAG_PARSE_ZLIB_HEADER;
+  }
+  else {
+    _otaFormat = 1;
+    return true;
+  }
+
+  _otaInflate = (tinfl_decompressor*)malloc(sizeof(tinfl_decompressor));
+  _otaDict    = (uint8_t*)malloc(TINFL_LZ_DICT_SIZE);
+  if(!_otaInflate || !_otaDict){
+    #ifdef WM_DEBUG_LEVEL
+    DEBUG_WM(WM_DEBUG_ERROR,F("[ERROR] OTA inflate out of memory"));
+    #endif
+    _otaFailReason = F("inflate out of memory");
+    otaInflateEnd();
+    return false;
+  }
+  tinfl_init(_otaInflate);
+  _otaDictOfs = 0;
+  _otaInflateStatus = TINFL_STATUS_NEEDS_MORE_INPUT;
+  _otaFormat = 2;
+
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(WM_DEBUG_VERBOSE,F("[OTA] compressed image, inflating"));
+  #endif
+  return true;
+}
+
+void WiFiManager::otaInflateEnd(){
+  free(_otaInflate);
+  free(_otaDict);
+  _otaInflate = nullptr;
+  _otaDict    = nullptr;
+}
+#endif
+
+// update ota stats and fire progress callback
+void WiFiManager::otaProgress(){
+  _otaStats.elapsed = (micros() - _otaStart) / 1000;
+  _otaStats.kbps    = _otaStats.elapsed ? (uint32_t)((uint64_t)_otaStats.bytes * 1000 / 1024 / _otaStats.elapsed) : 0;
+  _otaStats.error   = _otaError;
+
+  #ifdef WM_EVENTLOG
+  if(_otaStats.done) logEvent(WM_EV_OTA_END, _otaHashMismatch ? 2 : !_otaError, _otaStats.bytes);
+  #endif
+
+  #ifdef WM_DEBUG_LEVEL
+  if(_otaStats.done) DEBUG_WM(WM_DEBUG_VERBOSE,F("[OTA] KB/s:"),_otaStats.kbps);
+  if(_otaStats.done) DEBUG_WM(WM_DEBUG_DEV,F("[OTA] max write us:"),_otaStats.writeMaxUs);
+  if(_otaStats.done) DEBUG_WM(WM_DEBUG_DEV,F("[OTA] write stalls:"),_otaStats.stalls);
+  #endif
+
+  if (_otaprogresscallback != NULL) {
+    _otaprogresscallback(_otaStats);  // @CALLBACK
+  }
+}
+
 // upload and ota done, show status
 void WiFiManager::handleUpdateDone() {
 	DEBUG_WM(WM_DEBUG_VERBOSE, F("<- Handle update done"));
 	// if (captivePortal()) return; // If captive portal redirect instead of displaying the page
 
-	String page = getHTTPHead(FPSTR(S_options)); // @token options
+	String page = getHTTPHead(WM_LS(S_options)); // @token options
 	String str  = FPSTR(HTTP_ROOT_MAIN);
   str.replace(FPSTR(T_t),_title);
-	str.replace(FPSTR(T_v), configPortalActive ? _apName : WiFi.localIP().toString()); // use ip if ap is not active for heading
+	str.replace(FPSTR(T_v), configPortalActive ? _apName : getWiFiState().ip.toString()); // use ip if ap is not active for heading
 	page += str;
 
-	if (Update.hasError()) {
-		page += FPSTR(HTTP_UPDATE_FAIL);
+  bool error = _otaError || Update.hasError();
+	if (error) {
+		page += WM_LS(HTTP_UPDATE_FAIL);
+    if(_otaFailReason) page += String(F("OTA Error: ")) + _otaFailReason;
     #ifdef ESP32
-    page += "OTA Error: " + (String)Update.errorString();
+    else page += "OTA Error: " + (String)Update.errorString();
     #else
-    page += "OTA Error: " + (String)Update.getError();
+    else page += "OTA Error: " + (String)Update.getError();
     #endif
 		DEBUG_WM(F("[OTA] update failed"));
 	}
 	else {
-		page += FPSTR(HTTP_UPDATE_SUCCESS);
+		page += WM_LS(HTTP_UPDATE_SUCCESS);
 		DEBUG_WM(F("[OTA] update ok"));
 	}
 	page += FPSTR(HTTP_END);
@@ -4008,7 +6378,7 @@ void WiFiManager::handleUpdateDone() {
 	HTTPSend(page);
 
 	delay(1000); // send page
-	if (!Update.hasError()) {
+	if (!error) {
 		ESP.restart();
 	}
 }
@@ -21,11 +21,26 @@
 #endif
 
 #include <vector>
+#include <atomic>
+#include <type_traits>
 
 // #define WM_MDNS            // includes MDNS, also set MDNS with sethostname
 // #define WM_FIXERASECONFIG  // use erase flash fix
 // #define WM_ERASE_NVS       // esp32 erase(true) will erase NVS 
 // #define WM_RTC             // esp32 info page will include reset reasons
+// #define WM_LANGPACK        // runtime language packs loaded from FS, selected by Accept-Language, see extras/langpack.js
+// #define WM_METRICS         // /status.json and prometheus /metrics endpoints for scraping, see addMetric()
+// #define WM_FASTCONNECT     // cache bssid, channel and optionally the ip lease of the last good connection for faster reconnects, see setFastConnect()
+// #define WM_MULTIAP         // esp32 remember up to WM_MULTIAP_MAX networks and connect to the best one in range, see addCredential()
+// #define WM_FASTDNS         // captive portal dns responder that drains all pending queries per process(), with per client rate limits
+// #define WM_PORTALTASK      // esp32 non blocking portal is processed on its own task, save callbacks are run from process(), see setPortalTask()
+// #define WM_ASYNCWEBSERVER  // esp32 portal served by ESPAsyncWebServer through wm_asyncserver.h, concurrent clients, handlers run from process() or the portal task
+// #define WM_DEBUG_DEFERRED  // debug lines are queued in a ring buffer and written to the debug port from process(), never blocking on Serial
+// #define WM_EVENTLOG        // binary event log of portal, connect, ota and app events in a ram ring, served at /events.bin, see logEvent() and extras/eventlog.js
+// #define WM_HTTPLIMIT       // per client token bucket rate limit on portal requests, scan and info pages coalesced onto one render, 429/503 when busy
+// #define WM_POWERSAVE       // esp32 modem sleep while connected, off while the config portal runs, see setPowerSave()
+// #define WM_ROAMING         // background roaming to a stronger bssid of the same ssid while connected, see setRoaming()
+// #define WM_OTA_INFLATE     // esp32 updater accepts gzip/zlib compressed images, inflated through a 32KB window, esp8266 core handles gzip images natively
 
 // #define WM_JSTEST                      // build flag for enabling js xhr tests
 // #define WIFI_MANAGER_OVERRIDE_STRINGS // build flag for using own strings include
@@ -72,6 +87,7 @@
     }
     #include <ESP8266WiFi.h>
     #include <ESP8266WebServer.h>
+    #include <bearssl/bearssl_hash.h> // ota sha256
 
     #ifdef WM_MDNS
         #include <ESP8266mDNS.h>
@@ -85,6 +101,11 @@
     #include <WiFi.h>
     #include <esp_wifi.h>  
     #include <Update.h>
+    #include <mbedtls/sha256.h> // ota sha256
+
+    #if defined(WM_FASTCONNECT) || defined(WM_MULTIAP)
+        #include <Preferences.h>
+    #endif
     
     #define WIFI_getChipId() (uint32_t)ESP.getEfuseMac()
     #define WM_WIFIOPEN   WIFI_AUTH_OPEN
@@ -99,6 +120,10 @@
         #endif
     #endif
 
+    #ifdef WM_ASYNCWEBSERVER
+        #include "wm_asyncserver.h" // after WebServer.h, uses its HTTPMethod and HTTPUpload
+    #endif
+
     #ifdef WM_ERASE_NVS
        #include <nvs.h>
        #include <nvs_flash.h>
@@ -108,6 +133,24 @@
         #include <ESPmDNS.h>
     #endif
 
+    #ifdef WM_OTA_INFLATE
+        #ifdef ESP_IDF_VERSION_MAJOR // IDF 4+
+        #if CONFIG_IDF_TARGET_ESP32 // ESP32/PICO-D4
+        #include "esp32/rom/miniz.h"
+        #elif CONFIG_IDF_TARGET_ESP32S2
+        #include "esp32s2/rom/miniz.h"
+        #elif CONFIG_IDF_TARGET_ESP32C3
+        #include "esp32c3/rom/miniz.h"
+        #elif CONFIG_IDF_TARGET_ESP32S3
+        #include "esp32s3/rom/miniz.h"
+        #else
+        #error Target CONFIG_IDF_TARGET is not supported
+        #endif
+        #else // ESP32 Before IDF 4.0
+        #include "rom/miniz.h"
+        #endif
+    #endif
+
     #ifdef WM_RTC
         #ifdef ESP_IDF_VERSION_MAJOR // IDF 4+
         #if CONFIG_IDF_TARGET_ESP32 // ESP32/PICO-D4
@@ -132,6 +175,45 @@
 #include <DNSServer.h>
 #include <memory>
 
+#ifndef WM_ROUTES_USER
+#define WM_ROUTES_USER      8   // max routes added with addRoute()
+#endif
+
+#ifdef WM_HTTPLIMIT
+    #ifndef WM_HTTP_CLIENTS
+    #define WM_HTTP_CLIENTS     8     // clients tracked for rate limiting
+    #endif
+    #ifndef WM_HTTP_RATE
+    #define WM_HTTP_RATE        5     // sustained requests per client per second
+    #endif
+    #ifndef WM_HTTP_BURST
+    #define WM_HTTP_BURST       15    // requests a client may make at once
+    #endif
+    #ifndef WM_HTTP_COALESCE_MS
+    #define WM_HTTP_COALESCE_MS 2000  // ms a rendered scan or info page is served again to any client
+    #endif
+    #ifndef WM_HTTP_MINHEAP
+    #define WM_HTTP_MINHEAP     12288 // free heap below which scan and info pages are refused with 503
+    #endif
+#endif
+
+#ifdef WM_FASTDNS
+    #ifdef ESP32
+        #include <lwip/sockets.h>
+    #else
+        #include <WiFiUdp.h>
+    #endif
+    #ifndef WM_DNS_BUDGET
+    #define WM_DNS_BUDGET       16  // max queries answered per processNextRequest()
+    #endif
+    #ifndef WM_DNS_CLIENTS
+    #define WM_DNS_CLIENTS      8   // clients tracked for rate limiting
+    #endif
+    #ifndef WM_DNS_RATE
+    #define WM_DNS_RATE         40  // max queries per client per second, extra queries are dropped
+    #endif
+#endif
+
 
 // Include wm strings vars
 // Pass in strings env override via WM_STRINGS_FILE
@@ -140,6 +222,175 @@
 #endif
 #include WM_STRINGS_FILE
 
+#if defined(WM_LANGPACK) || defined(WM_EVENTLOG)
+    #include <FS.h>
+#endif
+
+#ifdef WM_LANGPACK
+
+    #ifndef WM_LANGPACK_CACHE
+    #define WM_LANGPACK_CACHE     16  // strings cached per pack, slot is id % WM_LANGPACK_CACHE
+    #endif
+    #ifndef WM_LANGPACK_CACHE_LEN
+    #define WM_LANGPACK_CACHE_LEN 256 // longer strings are read from the file every time
+    #endif
+
+    // language pack token ids, generated from WM_LANGPACK_TOKENS in wm_consts
+    #define WM_LANGPACK_ENUM(id, str) WM_LP_##id,
+    typedef enum {
+        WM_LANGPACK_TOKENS(WM_LANGPACK_ENUM)
+        WM_LP_MAX
+    } wm_langtoken_t;
+
+    // language pack index entry, as stored in pack file
+    typedef struct {
+        uint16_t id;     // wm_langtoken_t
+        uint16_t len;    // string length in bytes, no null
+        uint32_t offset; // from start of file
+    } wm_langpack_entry_t;
+
+    // render strings, language pack lookup with compiled string fallback
+    #define WM_LS(token)   getLangString(WM_LP_##token, FPSTR(token))
+    #define WM_LSM(menuid) getLangString((uint16_t)(WM_LP_HTTP_PORTAL_MENU_0 + (menuid)), FPSTR(HTTP_PORTAL_MENU[menuid]))
+#else
+    #define WM_LS(token)   FPSTR(token)
+    #define WM_LSM(menuid) HTTP_PORTAL_MENU[menuid]
+#endif
+
+// info page fields, X(id, volatile), static fields are rendered once and cached while the portal is up
+#define WM_INFO_FIELDS(X) \
+  X(esphead,false) X(uptime,true) X(chipid,false) X(chiprev,false) X(fchipid,false) \
+  X(idesize,false) X(flashsize,false) X(corever,false) X(bootver,false) X(cpufreq,false) \
+  X(freeheap,true) X(memsketch,false) X(memsmeter,false) X(lastreset,false) X(temp,true) \
+  X(wifihead,true) X(conx,true) X(stassid,true) X(rssi,true) X(staip,true) \
+  X(stagw,true) X(stasub,true) X(dnss,true) X(host,true) X(stamac,false) \
+  X(autoconx,true) X(apssid,true) X(apip,true) X(apmac,false) X(aphost,true) \
+  X(apbssid,true) X(aboutver,false) X(aboutarduinover,false) X(aboutsdkver,false) X(aboutdate,false)
+
+#define WM_INFO_ENUM(id, vol) WM_INFO_##id,
+typedef enum { WM_INFO_FIELDS(WM_INFO_ENUM) WM_INFO_MAX } wm_info_t;
+
+// ota upload progress, see setOtaProgressCallback
+typedef struct {
+  uint32_t bytes;       // bytes written to flash
+  uint32_t elapsed;     // ms since upload start
+  uint32_t kbps;        // average throughput KB/s
+  uint32_t chunks;      // upload chunks received
+  uint32_t chunkMaxUs;  // longest gap between chunks, network side latency
+  uint32_t writeMaxUs;  // longest Update.write
+  uint32_t stalls;      // writes longer than WM_OTA_STALL_US, flash erase/write stalls
+  bool     done;        // upload finished
+  bool     error;       // upload failed, aborted or sha256 mismatch
+} wm_ota_stats_t;
+
+#ifndef WM_OTA_STALL_US
+#define WM_OTA_STALL_US     50000 // Update.write time counted as a stall
+#endif
+
+#ifdef WM_ROAMING
+// roam attempt result, see setRoamCallback
+typedef struct {
+  uint8_t  from[6];     // bssid before roam
+  uint8_t  to[6];       // target bssid
+  int8_t   fromRssi;    // averaged rssi that triggered the roam
+  int8_t   toRssi;      // target rssi from scan
+  uint8_t  channel;     // target channel
+  uint32_t downtime;    // ms from re-association start to connected, or to giving up
+  bool     success;
+} wm_roam_event_t;
+#endif
+
+#if defined(WM_ASYNCWEBSERVER) && !defined(ESP32)
+    #warning "WM_ASYNCWEBSERVER is esp32 only"
+    #undef WM_ASYNCWEBSERVER
+#endif
+
+#if defined(WM_POWERSAVE) && !defined(ESP32)
+    #warning "WM_POWERSAVE is esp32 only"
+    #undef WM_POWERSAVE
+#endif
+
+#ifdef WM_POWERSAVE
+    #define WM_PS_BEACON_US       102400 // default ap beacon interval, 100 TU
+    #define WM_PS_LISTEN_INTERVAL 3      // beacons between WIFI_PS_MAX_MODEM wakeups, sdk default
+#endif
+
+#ifdef WM_PORTALTASK
+    #ifndef ESP32
+        #warning "WM_PORTALTASK is esp32 only"
+        #undef WM_PORTALTASK
+    #endif
+    #ifndef WM_PORTALTASK_QUEUE
+    #define WM_PORTALTASK_QUEUE 8 // deferred callbacks waiting for process(), power of 2
+    #endif
+#endif
+
+#ifdef WM_FASTCONNECT
+    #ifndef WM_FASTCONNECT_FAILS
+    #define WM_FASTCONNECT_FAILS 3 // cached connects missed in a row before the cache is dropped
+    #endif
+#endif
+
+#ifdef WM_MULTIAP
+    #ifndef ESP32
+        #warning "WM_MULTIAP is esp32 only"
+        #undef WM_MULTIAP
+    #endif
+    #ifndef WM_MULTIAP_MAX
+    #define WM_MULTIAP_MAX      4 // remembered networks
+    #endif
+#endif
+
+#ifdef WM_EVENTLOG
+    #ifndef WM_EVENTLOG_SIZE
+    #define WM_EVENTLOG_SIZE    64 // events kept in ram, 12 bytes each
+    #endif
+
+    // event ids, stored in logs, never renumber, keep extras/eventlog.js in sync
+    typedef enum {
+        WM_EV_BOOT           = 0x01, // arg reset reason
+        WM_EV_PORTAL_START   = 0x02, // arg 0 config portal, 1 web portal
+        WM_EV_PORTAL_STOP    = 0x03,
+        WM_EV_CONX_ATTEMPT   = 0x04,
+        WM_EV_CONX_RESULT    = 0x05, // arg wl_status_t, val ms
+        WM_EV_STA_DISCONNECT = 0x06, // arg disconnect reason
+        WM_EV_WIFI_SAVE      = 0x07,
+        WM_EV_PARAM_SAVE     = 0x08, // arg params count
+        WM_EV_OTA_START      = 0x09,
+        WM_EV_OTA_END        = 0x0A, // arg 1 ok, 0 failed, 2 sha256 mismatch, val bytes
+        WM_EV_ROAM           = 0x0B, // arg 1 ok, val downtime ms
+        WM_EV_MQTT_STATE     = 0x40, // application events from 0x40, val mqtt state()
+        WM_EV_USER           = 0x80  // free for application use
+    } wm_event_t;
+
+    // event record, little endian, as served and stored
+    typedef struct {
+        uint32_t ms;     // millis()
+        uint16_t seq;    // running count, gaps are lost events
+        uint8_t  id;     // wm_event_t
+        uint8_t  arg;
+        int32_t  val;
+    } wm_eventrec_t;
+
+    // log header, magic "WMEV", version, record size, count, uptime at read
+    typedef struct {
+        char     magic[4];
+        uint8_t  version;
+        uint8_t  recsize;
+        uint16_t count;
+        uint32_t now;
+    } wm_eventhdr_t;
+#endif
+
+#ifdef WM_METRICS
+    #ifndef WM_METRICS_BUFSIZE
+    #define WM_METRICS_BUFSIZE  1024 // status/metrics render buffer, allocated with WiFiManager
+    #endif
+    #ifndef WM_METRICS_USER
+    #define WM_METRICS_USER     4    // max user gauges, see addMetric()
+    #endif
+#endif
+
 // prep string concat vars
 #define WM_STRING2(x) #x
 #define WM_STRING(x) WM_STRING2(x)    
@@ -234,6 +485,45 @@ class WiFiManagerParameter {
 };
 
 
+#ifdef WM_FASTDNS
+/**
+    Captive portal dns responder, answers every A query with the AP ip
+    AAAA, HTTPS and other types get an empty NOERROR answer so clients fall back to ipv4 right away
+    Responses are built in place in a fixed packet buffer, nothing is allocated per query
+*/
+class WiFiManagerDNS {
+  public:
+    ~WiFiManagerDNS();
+    bool        start(uint16_t port, const IPAddress &ip);
+    void        stop();
+    uint8_t     processNextRequest(); // drains up to WM_DNS_BUDGET pending queries, returns answered count
+
+    uint32_t    getQueries() const { return _queries; }
+    uint32_t    getDropped() const { return _dropped; }
+
+  protected:
+    size_t      answer(size_t len);
+    bool        allow(uint32_t ip);
+
+    #ifdef ESP32
+    int         _sock    = -1;
+    #else
+    WiFiUDP     _udp;
+    bool        _started = false;
+    #endif
+    uint8_t     _buf[512];        // max udp dns message
+    uint8_t     _answer[16];      // prebuilt A record, name pointer to the question
+    uint32_t    _queries = 0;
+    uint32_t    _dropped = 0;     // malformed or rate limited
+
+    struct {
+      uint32_t ip;
+      uint32_t window;            // second the count belongs to
+      uint16_t count;
+    } _clients[WM_DNS_CLIENTS] = {};
+};
+#endif
+
     // debugging
     typedef enum {
         WM_DEBUG_SILENT    = 0, // debug OFF but still compiled for runtime
@@ -244,6 +534,40 @@ class WiFiManagerParameter {
         WM_DEBUG_MAX       = 5  // MAX extra dev auditing, var dumps etc (MAX+1 will print timing,mem and frag info)
     } wm_debuglevel_t;
 
+    // compile time debug threshold, calls above this level compile to nothing, setDebugOutput cannot raise past it
+    #ifndef WM_DEBUG_COMPILE_LEVEL
+    #define WM_DEBUG_COMPILE_LEVEL WM_DEBUG_MAX
+    #endif
+
+    // DEBUG_WM(level,...) level detection, the level is the first argument only when it is a wm_debuglevel_t
+    // other first arguments are never evaluated here, so messages only cost anything when they are printed
+    template <typename T> struct wm_is_debuglevel : std::is_same<typename std::decay<T>::type, wm_debuglevel_t> {};
+    template <typename F> inline uint8_t wm_debugLevelOf(std::true_type, F f){ return (uint8_t)f(); }
+    template <typename F> inline uint8_t wm_debugLevelOf(std::false_type, F){ return WM_DEBUG_NOTIFY; }
+    #define WM_DEBUG_FIRST(a, ...) a
+    #define WM_DEBUG_LVL(x) wm_debugLevelOf(wm_is_debuglevel<decltype(x)>(), [&](){ return x; })
+
+#ifdef WM_DEBUG_DEFERRED
+    #ifndef WM_DEBUG_RINGSIZE
+    #define WM_DEBUG_RINGSIZE 2048 // queued debug output, power of 2, lines are dropped when full
+    #endif
+    #ifndef WM_DEBUG_LINE
+    #define WM_DEBUG_LINE     160  // max formatted line, longer lines are truncated
+    #endif
+
+    // stack line buffer a debug line is formatted into before it is queued
+    class WiFiManagerDebugLine : public Print {
+      public:
+        size_t write(uint8_t c) override {
+          if(len >= WM_DEBUG_LINE - 1) return 0; // keep room for newline
+          buf[len++] = c;
+          return 1;
+        }
+        char   buf[WM_DEBUG_LINE];
+        size_t len = 0;
+    };
+#endif
+
 class WiFiManager
 {
   public:
@@ -264,7 +588,8 @@ class WiFiManager
     bool          stopConfigPortal();
     
     //manually start the web portal, autoconnect does this automatically on connect failure    
-    void          startWebPortal();
+    //scrapeOnly serves only /metrics, /status.json and addRoute() routes, for a portal left open on the station lan
+    void          startWebPortal(bool scrapeOnly = false);
 
     //manually stop the web portal if started manually
     void          stopWebPortal();
@@ -272,6 +597,19 @@ class WiFiManager
     // Run webserver processing, if setConfigPortalBlocking(false)
     boolean       process();
 
+    // ms the next process() call can be put off for, 0 if it has work now, for loops that sleep between events
+    unsigned long getProcessDelay();
+
+    //called from other tasks when process() has work queued, to wake a loop sleeping on getProcessDelay()
+    void          setProcessWakeCallback( std::function<void()> func );
+
+    #ifdef WM_PORTALTASK
+    // process the non blocking config portal and web portal on their own task pinned to core
+    // process() must still be called, it runs the save callbacks on the caller's task and reports connect
+    // presave, reset and ota callbacks are run on the portal task, they must complete before the portal continues
+    void          setPortalTask(bool enable, uint8_t core = 0, uint8_t priority = 1, uint32_t stack = 6144);
+    #endif
+
     // get the AP name of the config portal, so it can be used in the callback
     String        getConfigPortalSSID();
     int           getRSSIasQuality(int RSSI);
@@ -298,6 +636,13 @@ class WiFiManager
     // returns the Parameters Count
     int           getParametersCount();
 
+    // portal route handler, responds through wm->server
+    typedef void (*wm_routefunc_t)(WiFiManager *wm);
+
+    // serve uri from the portal route table, checked before the built in pages, up to WM_ROUTES_USER routes
+    // uri is not copied, pass a literal or a string that outlives the portal
+    bool          addRoute(const char *uri, wm_routefunc_t func, HTTPMethod method = HTTP_ANY);
+
     // SET CALLBACKS
 
     //called after AP mode and config portal has started
@@ -324,9 +669,20 @@ class WiFiManager
     //called just before doing OTA update
     void          setPreOtaUpdateCallback( std::function<void()> func );
 
+    //called for each OTA upload chunk and when the upload ends, stats.done
+    void          setOtaProgressCallback( std::function<void(const wm_ota_stats_t&)> func );
+
     //called when config portal is timeout
     void          setConfigPortalTimeoutCallback( std::function<void()> func );
 
+    //called when the config portal ap, web server and dns are up and clients can be served
+    void          setPortalReadyCallback( std::function<void()> func );
+
+    #ifdef WM_ROAMING
+    //called after each roam attempt
+    void          setRoamCallback( std::function<void(const wm_roam_event_t&)> func );
+    #endif
+
     //sets timeout before AP,webserver loop ends and exits even if there has been no setup.
     //useful for devices that failed to connect at some point and got stuck in a webserver loop
     //in seconds setConfigPortalTimeout is a new name for setTimeout, ! not used if setConfigPortalBlocking
@@ -444,6 +800,50 @@ class WiFiManager
 
     // get last connection result, includes autoconnect and wifisave
     uint8_t       getLastConxResult();
+
+    // get ms from connect start to connected (has ip) of the last successful connect, 0 if none
+    unsigned long getLastConxTime();
+
+    // get ms from startConfigPortal to the ap, web server and dns being up, of the last config portal
+    unsigned long getPortalReadyTime();
+
+    #ifdef WM_FASTCONNECT
+    // reconnect to the bssid and channel of the last good connection without a scan, falls back to a normal connect on failure
+    // cacheip also reuses the last ip/gw/subnet/dns instead of waiting on dhcp, only if no static ip is set
+    void          setFastConnect(bool enable, bool cacheip = false);
+
+    // true if the last successful connect used the cache
+    bool          getFastConnected();
+    #endif
+
+    #ifdef WM_POWERSAVE
+    // modem sleep while connected, WIFI_PS_MIN_MODEM wakes for every dtim beacon, WIFI_PS_MAX_MODEM every WM_PS_LISTEN_INTERVAL beacons
+    // power save is off while the config portal runs and restored when it closes
+    // dtim is the ap dtim period, the sdk does not report it, only used for getPowerSaveInterval()
+    void          setPowerSave(wifi_ps_type_t mode, uint8_t dtim = 1);
+
+    // ms between radio wakeups in the current mode, 0 if the radio is not sleeping
+    unsigned long getPowerSaveInterval();
+
+    // round ms up to a whole number of radio wakeups, to time periodic traffic for when the radio is awake anyway
+    unsigned long alignToPowerSave(unsigned long ms);
+    #endif
+
+    #ifdef WM_ROAMING
+    // roam to a stronger bssid of the current ssid, checked from process()
+    // a background scan starts when the averaged rssi stays below threshold dBm,
+    // the best bssid must be at least hysteresis dB stronger than the current one
+    void          setRoaming(bool enable, int8_t threshold = -75, uint8_t hysteresis = 8);
+    #endif
+
+    #ifdef WM_MULTIAP
+    // remember a network, networks are also remembered on every successful connect
+    // when full the least recently connected network is replaced
+    bool          addCredential(const char *ssid, const char *pass);
+
+    // forget all remembered networks, also done by resetSettings
+    void          clearCredentials();
+    #endif
     
     // get a status as string
     String        getWLStatusString(uint8_t status);    
@@ -497,10 +897,39 @@ class WiFiManager
     // get hostname helper
     String        getWiFiHostname();
 
+    #ifdef WM_LANGPACK
+    // add a language pack file (see extras/langpack.js), packs are selected per request from Accept-Language
+    // strings not found in a pack fall back to compiled strings, returns false if pack is invalid
+    bool          addLanguagePack(fs::FS &fs, const char *path);
+    #endif
+
+    #ifdef WM_EVENTLOG
+    // add an event to the log, safe from any task, eg. logEvent(WM_EV_MQTT_STATE, 0, mqtt.state())
+    void          logEvent(uint8_t id, uint8_t arg = 0, int32_t val = 0);
+    // copy the log, header then records oldest first, returns bytes written
+    size_t        readEventLog(uint8_t *buf, size_t size);
+    // append events to a file from process() before they are overwritten, file is rotated to path.1 at max bytes
+    void          setEventLogSpill(fs::FS &fs, const char *path, size_t max = 16384);
+    // write unsaved events to the spill file now, eg. before restart
+    void          flushEventLog();
+    #endif
+
+    #ifdef WM_METRICS
+    // add a gauge to /status.json and /metrics, eg. addMetric("mqtt_queue",[](){ return queue.size(); })
+    // name is not copied and should be [a-z0-9_], func is called on every scrape so keep it cheap
+    bool          addMetric(const char *name, std::function<int32_t()> func);
+    #endif
 
+
+    #ifdef WM_FASTDNS
+    std::unique_ptr<WiFiManagerDNS>   dnsServer;
+    #else
     std::unique_ptr<DNSServer>        dnsServer;
+    #endif
 
-    #if defined(ESP32) && defined(WM_WEBSERVERSHIM)
+    #if defined(ESP32) && defined(WM_ASYNCWEBSERVER)
+        using WM_WebServer = WiFiManagerAsyncServer;
+    #elif defined(ESP32) && defined(WM_WEBSERVERSHIM)
         using WM_WebServer = WebServer;
     #else
         using WM_WebServer = ESP8266WebServer;
@@ -527,6 +956,9 @@ class WiFiManager
     unsigned long _configPortalStart      = 0; // ms config portal start time (updated for timeouts)
     unsigned long _webPortalAccessed      = 0; // ms last web access time
     uint8_t       _lastconxresult         = WL_IDLE_STATUS; // store last result when doing connect operations
+    unsigned long _lastconxtime           = 0; // ms to connect of last successful connectWifi
+    unsigned long _portalReadyTime        = 0; // ms from startConfigPortal to portal ready
+    unsigned long _apStartTimeout         = 2000; // ms to wait for the softap to start with an ip
     int           _numNetworks            = 0; // init index for numnetworks wifiscans
     unsigned long _lastscan               = 0; // ms for timing wifi scans
     unsigned long _startscan              = 0; // ms for timing wifi scans
@@ -633,6 +1065,166 @@ protected:
 
     String        _wificountry            = "";  // country code, @todo define in strings lang
 
+    #ifdef WM_LANGPACK
+    // language packs
+    // indexes and a few short strings of packs used by the portal are held in ram, other strings are read from the file on render
+    typedef struct {
+      fs::FS  *fs;
+      String   path;
+      String   lang;                                // i18n lang code from pack header, eg. es-ES
+      std::vector<wm_langpack_entry_t> index;       // read on first use, validated and sorted by id
+      String   cache[WM_LANGPACK_CACHE];            // recently read strings
+      uint16_t cacheId[WM_LANGPACK_CACHE];          // token id in each cache slot, WM_LP_MAX empty
+    } wm_langpack_t;
+
+    std::vector<wm_langpack_t>        _langpacks;
+    fs::File      _langpackFile;                             // loaded pack file, kept open while portal runs
+    int8_t        _langpackLoaded         = -1; // _langpacks index whose file is open, -1 none
+    int8_t        _langpackSelected       = -1; // _langpacks index for current request, -1 compiled strings
+
+    int8_t        selectLanguagePack(const String &acceptlang);
+    bool          loadLanguagePack(int8_t idx);
+    bool          loadLanguagePackIndex(wm_langpack_t &pack);
+    void          unloadLanguagePack();
+    String        getLangString(uint16_t id, const __FlashStringHelper *fallback);
+    #endif
+
+    #ifdef WM_FASTCONNECT
+    // last good connection, esp32 nvs, esp8266 rtc memory
+    typedef struct {
+      uint32_t    check;          // checksum of the fields below
+      char        ssid[33];
+      uint8_t     bssid[6];
+      uint8_t     channel;
+      uint32_t    ip;             // 0 if lease not cached
+      uint32_t    gw;
+      uint32_t    sn;
+      uint32_t    dns;
+    } wm_fastconnect_t;
+
+    boolean       _fastConnect            = false; // use cached bssid/channel on connect
+    boolean       _fastConnectIP          = false; // use cached ip lease on connect
+    boolean       _fastConnected          = false; // last connect used the cache
+    unsigned long _fastConnectTimeout     = 4000;  // ms to wait for a cached connect before falling back
+
+    uint8_t       wifiConnectFast();
+    bool          fastConnectLoad(wm_fastconnect_t &fc);
+    void          fastConnectSave();
+    void          fastConnectClear();
+    uint32_t      fastConnectCheck(const wm_fastconnect_t &fc);
+    #endif
+
+    #ifdef WM_MULTIAP
+    // credential ring, stored as one nvs blob
+    typedef struct {
+      char        ssid[33];
+      char        pass[64];
+      uint8_t     failures;       // failed attempts since last success
+      uint32_t    seq;            // success order, higher is more recent, 0 empty slot
+    } wm_credential_t;
+
+    unsigned long _multiAPTimeout         = 8000; // ms to wait on each remembered network
+
+    uint8_t       wifiConnectMulti();
+    bool          credentialsLoad(wm_credential_t *creds);
+    void          credentialsSave(const wm_credential_t *creds);
+    void          credentialPersist();
+    bool          credentialStore(const String &ssid, const String &pass);
+    #endif
+
+    #ifdef WM_POWERSAVE
+    wifi_ps_type_t _powerSave             = WIFI_PS_NONE;
+    uint8_t       _psDtim                 = 1;     // ap dtim period in beacons
+    boolean       _psSuspended            = false; // config portal running, radio kept awake
+
+    void          powerSaveApply();
+    #endif
+
+    #ifdef WM_ROAMING
+    boolean       _roaming                = false;
+    int8_t        _roamThreshold          = -75;   // dBm averaged rssi to start looking
+    uint8_t       _roamHysteresis         = 8;     // dB a candidate must beat the current rssi by
+    uint8_t       _roamLowSamples         = 5;     // consecutive low samples before scanning
+    unsigned long _roamSampleInterval     = 1000;  // ms between rssi samples
+    unsigned long _roamScanInterval       = 60000; // min ms between roam scans
+    unsigned long _roamTimeout            = 5000;  // ms to wait for re-association
+
+    uint8_t       _roamState              = 0; // 0 monitoring, 1 scanning, 2 re-associating
+    volatile bool _roamLeft               = false; // old ap left while re-associating, set from the wifi event
+    uint8_t       _roamLowCount           = 0;
+    int16_t       _roamRssi               = 0; // averaged rssi, 0 not sampled yet
+    unsigned long _roamLastSample         = 0;
+    unsigned long _roamLastScan           = 0;
+    unsigned long _roamStart              = 0;
+    uint32_t      _roamCount              = 0; // successful roams
+    wm_roam_event_t _roamEvent            = {};
+
+    void          roamProcess();
+    bool          roamSelect();
+    void          roamDone(bool success);
+    #endif
+
+    #ifdef WM_PORTALTASK
+    enum { WM_PT_SAVEWIFI = 1, WM_PT_SAVEPARAMS };
+
+    boolean       _portalTaskEnabled      = false;
+    uint8_t       _portalTaskCore         = 0;
+    uint8_t       _portalTaskPriority     = 1;
+    uint32_t      _portalTaskStack        = 6144;
+    TaskHandle_t  _portalTask             = NULL; // cleared by portalTaskStop() once the task has exited
+    SemaphoreHandle_t _portalTaskDone     = NULL; // given by the task as it exits, the join in portalTaskStop()
+    SemaphoreHandle_t _portalTaskMux      = NULL; // recursive, wifi, scan and portal state, see portalLock()
+    std::atomic<bool>    _portalTaskRun{false};
+    std::atomic<uint8_t> _portalTaskState{WL_IDLE_STATUS}; // last non idle processConfigPortal result, consumed by process()
+
+    // single producer (portal task) single consumer (process) ring of deferred callbacks
+    uint8_t       _portalTaskEvents[WM_PORTALTASK_QUEUE];
+    std::atomic<uint8_t> _portalTaskHead{0};
+    std::atomic<uint8_t> _portalTaskTail{0};
+
+    static void   portalTask(void *arg);
+    void          portalTaskStart();
+    void          portalTaskStop();
+    bool          portalLock(TickType_t wait = portMAX_DELAY);
+    void          portalUnlock();
+    bool          portalTaskDefer(uint8_t event);
+    void          portalTaskDispatch();
+    #endif
+
+    #ifdef WM_METRICS
+    // scrape endpoints, rendered into _metricsBuf with snprintf, no heap use
+    typedef struct {
+      const char *name;
+      std::function<int32_t()> func;
+    } wm_metric_t;
+
+    wm_metric_t   _metrics[WM_METRICS_USER];
+    uint8_t       _metricsCount           = 0;
+    char          _metricsBuf[WM_METRICS_BUFSIZE];
+    uint32_t      _portalHits             = 0; // portal page requests, scrapes not included
+    uint32_t      _conxAttempts           = 0; // connectWifi calls
+    volatile uint32_t _staDisconnects     = 0; // sta disconnect events, each one triggers a reconnect
+
+    void          handleStatusJson();
+    void          handleMetrics();
+    size_t        renderMetrics(bool prom);
+    #endif
+
+    #ifdef WM_EVENTLOG
+    wm_eventrec_t _events[WM_EVENTLOG_SIZE];
+    uint32_t      _eventCount             = 0; // events logged, ring index is _eventCount % WM_EVENTLOG_SIZE
+    uint32_t      _eventSpilled           = 0; // events written to the spill file
+    fs::FS       *_eventFS                = nullptr;
+    const char   *_eventPath              = nullptr;
+    size_t        _eventMax               = 0;
+    #ifdef ESP32
+    portMUX_TYPE  _eventMux               = portMUX_INITIALIZER_UNLOCKED;
+    #endif
+
+    void          handleEvents();
+    void          eventLogSpill(bool force);
+    #endif
+
     // wrapper functions for handling setting and unsetting persistent for now.
     bool          esp32persistent         = false;
     bool          _hasBegun               = false; // flag wm loaded,unloaded
@@ -649,6 +1241,7 @@ protected:
 #endif
 
     bool          startAP();
+    bool          waitForAP(unsigned long timeout);
     void          setupDNSD();
     void          setupHTTPServer();
 
@@ -670,15 +1263,76 @@ protected:
     void          handleWifi(boolean scan);
     void          handleWifiSave();
     void          handleInfo();
+    void          handleInfoJson();
     void          handleReset();
 
     void          handleExit();
     void          handleClose();
     // void          handleErase();
     void          handleErase(boolean opt);
+    void          handleWifiScan();
+    void          handleWifiNoScan();
+    void          handleEraseConfig();
     void          handleParam();
     void          handleWiFiStatus();
     void          handleRequest();
+
+    // portal routes, looked up by uri from the not found handler, no handler object per route
+    typedef void (WiFiManager::*wm_handler_t)();
+    typedef struct {
+      const char     *uri;     // PROGMEM
+      HTTPMethod      method;
+      wm_handler_t    handler;
+      uint8_t         flags;   // WM_ROUTE_HEAVY, WM_ROUTE_SCRAPE
+    } wm_route_t;
+
+    #define WM_ROUTE_HEAVY  0x01 // scans or renders a lot, coalesced and refused when low on heap with WM_HTTPLIMIT
+    #define WM_ROUTE_SCRAPE 0x02 // read only status, also served by a scrape only web portal
+
+    typedef struct {
+      const char     *uri;
+      HTTPMethod      method;
+      wm_routefunc_t  func;
+    } wm_userroute_t;
+
+    static const wm_route_t _routes[]; // sorted by uri for binary search
+    wm_userroute_t _userRoutes[WM_ROUTES_USER];
+    uint8_t       _userRoutesCount        = 0;
+    bool          _webPortalScrapeOnly    = false; // startWebPortal(true), built in pages other than WM_ROUTE_SCRAPE are not served
+
+    void          handleRoute();
+
+    #ifdef WM_HTTPLIMIT
+    struct {
+      uint32_t      ip;
+      uint32_t      credit;  // ms of request budget, 1000 / WM_HTTP_RATE per request
+      unsigned long last;
+    } _httpClients[WM_HTTP_CLIENTS] = {};
+
+    String        _coalescePage;           // last rendered heavy page
+    int8_t        _coalesceRoute          = -1; // _routes index of _coalescePage, -1 none
+    int8_t        _coalesceCapture        = -1; // _routes index HTTPSend is rendering for
+    int8_t        _coalesceLang           = -1;
+    unsigned long _coalesceTime           = 0;
+    uint32_t      _httpLimited            = 0; // 429 responses
+    uint32_t      _httpOverloaded         = 0; // 503 responses
+    uint32_t      _httpCoalesced          = 0; // heavy pages served from _coalescePage
+
+    bool          httpAllow(uint32_t ip);
+    #endif
+
+    // wifi state read by the page renderers, refreshed on the first read after a wifi event or config change
+    typedef struct {
+      uint8_t     status;
+      String      ssid;   // configured ssid
+      String      psk;    // configured psk
+      IPAddress   ip;
+    } wm_wifistate_t;
+
+    wm_wifistate_t    _wifiState;
+    std::atomic<bool> _wifiStateDirty{true};
+
+    const wm_wifistate_t& getWiFiState();
     void          handleParamSave();
     void          doParamSave();
 
@@ -690,12 +1344,48 @@ protected:
 	void          handleUpdate();
 	void          handleUpdating();
 	void          handleUpdateDone();
+    void          otaProgress();
+    bool          otaWrite(uint8_t *data, size_t len);
+    bool          otaFlashWrite(uint8_t *data, size_t len);
+
+    // ota upload state, expected sha256 is passed as /u?sha256=<hex>
+    wm_ota_stats_t _otaStats              = {};
+    unsigned long _otaStart               = 0; // micros at upload start
+    unsigned long _otaLastChunk           = 0; // micros at last chunk
+    unsigned long _otaTimeoutSAV          = 0; // cp timeout, restored on failure
+    bool          _otaError               = false; // stop writing after first error
+    bool          _otaHashMismatch        = false;
+    const __FlashStringHelper *_otaFailReason = nullptr; // why the upload failed, nullptr for Update errors
+    bool          _otaVerify              = false; // sha256 supplied with upload
+    uint8_t       _otaDigest[32];                  // expected sha256
+    #ifdef ESP32
+    mbedtls_sha256_context _otaSha;
+    #else
+    br_sha256_context _otaSha;
+    #endif
+
+    #ifdef WM_OTA_INFLATE
+    // compressed upload, decompressor and window are only allocated while an upload is inflating
+    uint8_t       _otaFormat              = 0; // 0 not detected, 1 raw image, 2 compressed
+    tinfl_decompressor *_otaInflate       = nullptr;
+    uint8_t      *_otaDict                = nullptr; // TINFL_LZ_DICT_SIZE output window, written to flash as it fills
+    size_t        _otaDictOfs             = 0;
+    uint32_t      _otaInflateFlags        = 0;
+    int           _otaInflateStatus       = 0; // tinfl_status
+
+    bool          otaInflateBegin(const uint8_t *data, size_t len, size_t &skip);
+    void          otaInflateEnd();
+    #endif
 
 
     // wifi platform abstractions
     bool          WiFi_Mode(WiFiMode_t m);
     bool          WiFi_Mode(WiFiMode_t m,bool persistent);
     bool          WiFi_Disconnect();
+    bool          WiFi_unpinSTA();
+    #ifdef ESP32
+    void          WiFi_storageRAM(bool ram);
+    #endif
     bool          WiFi_enableSTA(bool enable);
     bool          WiFi_enableSTA(bool enable,bool persistent);
     bool          WiFi_eraseConfig();
@@ -760,6 +1450,9 @@ protected:
     String        encryptionTypeStr(uint8_t authmode);
     void          reportStatus(String &page);
     String        getInfoData(String id);
+    String        getInfoData(wm_info_t id, bool json = false);
+    PGM_P         getInfoValues(wm_info_t id, String &v1, String &v2);
+    String        jsonEscape(String str);
 
     // flags
     boolean       connect             = false;
@@ -767,6 +1460,12 @@ protected:
     boolean       reset               = false;
     boolean       configPortalActive  = false;
 
+    std::vector<String> _infoCache[2]; // rendered static info fields, [0] html, [1] json
+
+    String        _rootCache;              // rendered root page up to the status, emptied on menu, title or head changes
+    String        _rootCacheHeading;       // heading the cache was rendered with
+    int8_t        _rootCacheLang      = -1; // language pack the cache was rendered with
+
 
     // these are state flags for portal mode, we are either in webportal mode(STA) or configportal mode(AP)
     // these are mutually exclusive as STA+AP mode is not supported due to channel restrictions and stability
@@ -816,14 +1515,37 @@ protected:
     #endif
 
     template <typename Generic>
-    void        DEBUG_WM(Generic text);
+    void        debugWM(Generic text);
 
     template <typename Generic>
-    void        DEBUG_WM(wm_debuglevel_t level,Generic text);
+    void        debugWM(wm_debuglevel_t level,Generic text);
     template <typename Generic, typename Genericb>
-    void        DEBUG_WM(Generic text,Genericb textb);
+    void        debugWM(Generic text,Genericb textb);
     template <typename Generic, typename Genericb>
-    void        DEBUG_WM(wm_debuglevel_t level, Generic text,Genericb textb);
+    void        debugWM(wm_debuglevel_t level, Generic text,Genericb textb);
+
+    // level is checked before any argument is evaluated, constant levels above WM_DEBUG_COMPILE_LEVEL are removed
+    #ifdef WM_DEBUG_LEVEL
+    #define DEBUG_WM(...) do { \
+      if(WM_DEBUG_LVL(WM_DEBUG_FIRST(__VA_ARGS__, 0)) <= WM_DEBUG_COMPILE_LEVEL && _debug && \
+         WM_DEBUG_LVL(WM_DEBUG_FIRST(__VA_ARGS__, 0)) <= _debugLevel) debugWM(__VA_ARGS__); \
+    } while(0)
+    #else
+    #define DEBUG_WM(...) do {} while(0)
+    #endif
+
+    #ifdef WM_DEBUG_DEFERRED
+    char          _debugRing[WM_DEBUG_RINGSIZE];
+    std::atomic<uint32_t> _debugHead{0};  // written by loggers
+    std::atomic<uint32_t> _debugTail{0};  // written by debugFlush
+    uint32_t      _debugDropped = 0;      // lines lost to a full ring
+    #ifdef ESP32
+    portMUX_TYPE  _debugMux = portMUX_INITIALIZER_UNLOCKED; // loggers on other tasks reserve ring space under it, memcpy only
+    #endif
+
+    void          debugPush(const char *line, size_t len);
+    void          debugFlush();
+    #endif
 
     // callbacks
     // @todo use cb list (vector) maybe event ids, allow no return value
@@ -835,7 +1557,13 @@ protected:
     std::function<void()> _saveparamscallback;
     std::function<void()> _resetcallback;
     std::function<void()> _preotaupdatecallback;
+    std::function<void(const wm_ota_stats_t&)> _otaprogresscallback;
     std::function<void()> _configportaltimeoutcallback;
+    std::function<void()> _processwakecallback;
+    std::function<void()> _portalreadycallback;
+    #ifdef WM_ROAMING
+    std::function<void(const wm_roam_event_t&)> _roamcallback;
+    #endif
 
     template <class T>
     auto optionalIPFromString(T *obj, const char *s) -> decltype(  obj->fromString(s)  ) {
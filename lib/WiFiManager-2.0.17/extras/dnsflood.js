@@ -0,0 +1,105 @@
+'use strict';
+
+// captive portal dns load generator, floods the AP with A/AAAA/HTTPS queries and reports answer rate and latency
+// usage: node dnsflood.js [server=192.168.4.1] [queries=5000] [sockets=8] [inflight=32]
+// join the portal AP first, all sockets share the host ip so WM_DNS_RATE applies to the whole run
+
+const dgram = require('dgram');
+
+const server = process.argv[2] || '192.168.4.1';
+const total = parseInt(process.argv[3] || '5000', 10);
+const socketCount = parseInt(process.argv[4] || '8', 10);
+const inflight = parseInt(process.argv[5] || '32', 10);
+const TIMEOUT = 1000;
+
+// what phones ask when they join, A, AAAA and HTTPS (65)
+const NAMES = ['connectivitycheck.gstatic.com', 'captive.apple.com', 'www.msftconnecttest.com', 'clients3.google.com'];
+const TYPES = [1, 28, 65];
+
+function query(id, name, type) {
+  const labels = name.split('.').map(function (l) {
+    return Buffer.concat([Buffer.from([l.length]), Buffer.from(l, 'ascii')]);
+  });
+  const head = Buffer.alloc(12);
+  head.writeUInt16BE(id, 0);
+  head.writeUInt16BE(0x0100, 2); // recursion desired
+  head.writeUInt16BE(1, 4);
+  const tail = Buffer.alloc(5);
+  tail.writeUInt16BE(type, 1);
+  tail.writeUInt16BE(1, 3);
+  return Buffer.concat([head].concat(labels, [tail]));
+}
+
+const pending = new Map(); // id -> { sent, type, timer }
+const latencies = [];
+const stats = { sent: 0, answered: 0, a: 0, empty: 0, bad: 0, timeout: 0 };
+let nextId = 0;
+let start;
+
+function finish(id) {
+  const p = pending.get(id);
+  if (!p) return null;
+  clearTimeout(p.timer);
+  pending.delete(id);
+  return p;
+}
+
+function onMessage(msg) {
+  if (msg.length < 12) return;
+  const p = finish(msg.readUInt16BE(0));
+  if (!p) return;
+  latencies.push(Number(process.hrtime.bigint() - p.sent) / 1e6);
+  stats.answered++;
+  const rcode = msg[3] & 0x0f;
+  const ancount = msg.readUInt16BE(6);
+  if (rcode !== 0) stats.bad++;
+  else if (p.type === 1 && ancount === 1) stats.a++;
+  else if (p.type !== 1 && ancount === 0) stats.empty++;
+  else stats.bad++;
+  pump();
+}
+
+const sockets = [];
+for (let i = 0; i < socketCount; i++) {
+  const s = dgram.createSocket('udp4');
+  s.on('message', onMessage);
+  sockets.push(s);
+}
+
+function send() {
+  const id = nextId++ & 0xffff;
+  const type = TYPES[stats.sent % TYPES.length];
+  const msg = query(id, NAMES[stats.sent % NAMES.length], type);
+  const p = { sent: process.hrtime.bigint(), type: type };
+  p.timer = setTimeout(function () {
+    if (finish(id)) {
+      stats.timeout++;
+      pump();
+    }
+  }, TIMEOUT);
+  pending.set(id, p);
+  sockets[stats.sent % sockets.length].send(msg, 53, server);
+  stats.sent++;
+}
+
+function pump() {
+  while (stats.sent < total && pending.size < inflight) send();
+  if (stats.sent >= total && pending.size === 0) report();
+}
+
+function pct(sorted, p) {
+  if (!sorted.length) return 0;
+  return sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * p))].toFixed(2);
+}
+
+function report() {
+  const secs = Number(process.hrtime.bigint() - start) / 1e9;
+  latencies.sort(function (a, b) { return a - b; });
+  console.log('sent', stats.sent, 'answered', stats.answered, 'timeout', stats.timeout, 'in', secs.toFixed(2) + 's');
+  console.log('answered/s', Math.round(stats.answered / secs), 'A ok', stats.a, 'empty ok', stats.empty, 'unexpected', stats.bad);
+  console.log('latency ms p50', pct(latencies, 0.5), 'p99', pct(latencies, 0.99), 'max', pct(latencies, 1));
+  sockets.forEach(function (s) { s.close(); });
+}
+
+start = process.hrtime.bigint();
+pump();
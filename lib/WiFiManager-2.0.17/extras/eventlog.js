@@ -0,0 +1,110 @@
+'use strict';
+
+// decodes a WiFiManager binary event log (WM_EVENTLOG) into a readable timeline
+// usage: node eventlog.js <events.bin|http://device/events.bin|http://device/events.bin?file=1> [...]
+// also takes raw spill files and mqtt payloads saved to disk, several inputs are decoded in order
+
+const fs = require('fs');
+const http = require('http');
+
+const REC_SIZE = 12;
+const HDR_SIZE = 12;
+
+// keep in sync with wm_event_t in WiFiManager.h
+const EVENTS = {
+  0x01: 'BOOT',
+  0x02: 'PORTAL_START',
+  0x03: 'PORTAL_STOP',
+  0x04: 'CONX_ATTEMPT',
+  0x05: 'CONX_RESULT',
+  0x06: 'STA_DISCONNECT',
+  0x07: 'WIFI_SAVE',
+  0x08: 'PARAM_SAVE',
+  0x09: 'OTA_START',
+  0x0a: 'OTA_END',
+  0x0b: 'ROAM',
+  0x40: 'MQTT_STATE'
+};
+
+const WL_STATUS = ['IDLE', 'NO_SSID_AVAIL', 'SCAN_COMPLETED', 'CONNECTED', 'CONNECT_FAILED', 'CONNECTION_LOST', 'DISCONNECTED'];
+const RESET_REASON = ['UNKNOWN', 'POWERON', 'EXT', 'SW', 'PANIC', 'INT_WDT', 'TASK_WDT', 'WDT', 'DEEPSLEEP', 'BROWNOUT', 'SDIO'];
+const MQTT_STATE = {
+  '-4': 'CONNECTION_TIMEOUT', '-3': 'CONNECTION_LOST', '-2': 'CONNECT_FAILED', '-1': 'DISCONNECTED', '0': 'CONNECTED',
+  '1': 'BAD_PROTOCOL', '2': 'BAD_CLIENT_ID', '3': 'UNAVAILABLE', '4': 'BAD_CREDENTIALS', '5': 'UNAUTHORIZED'
+};
+const OTA_RESULT = ['FAILED', 'OK', 'SHA256_MISMATCH'];
+
+function describe(e) {
+  switch (e.id) {
+    case 0x01: return 'reset=' + (RESET_REASON[e.arg] || e.arg);
+    case 0x02: return e.arg ? 'web portal' : 'config portal';
+    case 0x05: return (WL_STATUS[e.arg] || 'status ' + e.arg) + ' in ' + e.val + ' ms';
+    case 0x06: return 'reason=' + e.arg;
+    case 0x08: return e.arg + ' params';
+    case 0x0a: return (OTA_RESULT[e.arg] || e.arg) + ' ' + e.val + ' bytes';
+    case 0x0b: return (e.arg ? 'ok' : 'failed') + ' ' + e.val + ' ms';
+    case 0x40: return MQTT_STATE[e.val] || 'state ' + e.val;
+  }
+  return e.arg || e.val ? 'arg=' + e.arg + ' val=' + e.val : '';
+}
+
+function decode(buf, name) {
+  let off = 0;
+  let now = null;
+  if (buf.length >= HDR_SIZE && buf.toString('ascii', 0, 4) === 'WMEV') {
+    const version = buf.readUInt8(4);
+    const recsize = buf.readUInt8(5);
+    if (version !== 1 || recsize !== REC_SIZE) throw new Error(name + ': unsupported log version ' + version + '/' + recsize);
+    now = buf.readUInt32LE(8);
+    off = HDR_SIZE;
+    console.log('#', name, buf.readUInt16LE(6), 'events, device uptime', (now / 1000).toFixed(3) + 's');
+  } else {
+    console.log('#', name, 'raw records');
+  }
+
+  let lastSeq = null;
+  for (; off + REC_SIZE <= buf.length; off += REC_SIZE) {
+    const e = {
+      ms: buf.readUInt32LE(off),
+      seq: buf.readUInt16LE(off + 4),
+      id: buf.readUInt8(off + 6),
+      arg: buf.readUInt8(off + 7),
+      val: buf.readInt32LE(off + 8)
+    };
+    if (e.id === 0x01) lastSeq = null; // counters restart on boot
+    if (lastSeq !== null && ((lastSeq + 1) & 0xffff) !== e.seq) {
+      console.log('  ... lost', ((e.seq - lastSeq - 1) & 0xffff), 'events');
+    }
+    lastSeq = e.seq;
+
+    const name = EVENTS[e.id] || (e.id >= 0x80 ? 'USER_' + e.id.toString(16) : 'EVENT_' + e.id.toString(16));
+    const ago = now !== null && e.ms <= now ? ('-' + ((now - e.ms) / 1000).toFixed(1) + 's').padStart(10) : ''.padStart(10);
+    console.log(('+' + (e.ms / 1000).toFixed(3) + 's').padStart(12), ago, ('#' + e.seq).padStart(6), name.padEnd(15), describe(e));
+  }
+}
+
+function read(src, cb) {
+  if (!/^https?:\/\//.test(src)) return cb(fs.readFileSync(src));
+  http.get(src, function (res) {
+    const chunks = [];
+    res.on('data', function (c) { chunks.push(c); });
+    res.on('end', function () {
+      if (res.statusCode !== 200) throw new Error(src + ': http ' + res.statusCode);
+      cb(Buffer.concat(chunks));
+    });
+  }).on('error', function (err) { throw err; });
+}
+
+const inputs = process.argv.slice(2);
+if (!inputs.length) {
+  console.log('usage: node eventlog.js <events.bin|http://device/events.bin> [...]');
+  process.exit(1);
+}
+
+(function next(i) {
+  if (i >= inputs.length) return;
+  read(inputs[i], function (buf) {
+    decode(buf, inputs[i]);
+    next(i + 1);
+  });
+})(0);
@@ -0,0 +1,126 @@
+'use strict';
+
+// portal http load harness, concurrent fast clients alongside slow clients that trickle their request
+// usage: node httpload.js <host[:port]> [clients=8] [requests=200] [slow=2] [path=/info]
+// responses are counted by status (429/503 from WM_HTTPLIMIT) and /metrics heap and limiter counters
+// are read before and after the run
+
+const net = require('net');
+
+const target = process.argv[2];
+const clients = parseInt(process.argv[3] || '8', 10);
+const total = parseInt(process.argv[4] || '200', 10);
+const slowCount = parseInt(process.argv[5] || '2', 10);
+const path = process.argv[6] || '/info';
+const SLOW_BYTE_MS = 200; // slow client sends one request byte per interval, like a phone on a weak link
+
+if (!target) {
+  console.log('usage: node httpload.js <host[:port]> [clients] [requests] [slow] [path]');
+  process.exit(1);
+}
+
+const statuses = {};
+
+function request(host, port, slow, cb, reqPath) {
+  const start = process.hrtime.bigint();
+  const req = Buffer.from('GET ' + (reqPath || path) + ' HTTP/1.1\r\nHost: ' + host + '\r\nConnection: close\r\n\r\n');
+  const sock = net.connect(port, host);
+  const chunks = [];
+  let bytes = 0;
+  let timer = null;
+  let finished = false;
+  const finish = function (ok) {
+    if (finished) return;
+    finished = true;
+    clearInterval(timer);
+    sock.destroy();
+    const body = Buffer.concat(chunks).toString('latin1');
+    const status = (body.match(/^HTTP\/1\.\d (\d+)/) || [])[1] || 'none';
+    cb(ok && bytes > 0, Number(process.hrtime.bigint() - start) / 1e6, status, body);
+  };
+  sock.on('connect', function () {
+    if (!slow) return sock.write(req);
+    let i = 0;
+    timer = setInterval(function () {
+      sock.write(req.subarray(i, i + 1));
+      if (++i >= req.length) clearInterval(timer);
+    }, SLOW_BYTE_MS);
+  });
+  sock.on('data', function (d) {
+    bytes += d.length;
+    if (chunks.length < 64) chunks.push(d);
+  });
+  sock.on('end', function () { finish(true); });
+  sock.on('error', function () { finish(false); });
+  sock.setTimeout(30000, function () { finish(false); });
+}
+
+function run(host, port, done) {
+  const latencies = [];
+  let started = 0;
+  let completed = 0;
+  let failed = 0;
+  let slowActive = true;
+  const t0 = process.hrtime.bigint();
+
+  // slow clients keep reconnecting for the whole run
+  function slowLoop() {
+    if (!slowActive) return;
+    request(host, port, true, slowLoop);
+  }
+  for (let i = 0; i < slowCount; i++) slowLoop();
+
+  function worker() {
+    if (started >= total) return;
+    started++;
+    request(host, port, false, function (ok, ms, status) {
+      if (ok) latencies.push(ms);
+      else failed++;
+      statuses[status] = (statuses[status] || 0) + 1;
+      if (++completed === total) {
+        slowActive = false;
+        report(latencies, failed, Number(process.hrtime.bigint() - t0) / 1e9);
+        done();
+      }
+      worker();
+    });
+  }
+  for (let i = 0; i < clients; i++) worker();
+}
+
+function pct(sorted, p) {
+  if (!sorted.length) return 0;
+  return sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * p))].toFixed(1);
+}
+
+function report(latencies, failed, secs) {
+  latencies.sort(function (a, b) { return a - b; });
+  console.log('requests', latencies.length + failed, 'failed', failed, 'clients', clients, 'slow', slowCount, 'in', secs.toFixed(2) + 's');
+  console.log('req/s', (latencies.length / secs).toFixed(1));
+  console.log('latency ms p50', pct(latencies, 0.5), 'p99', pct(latencies, 0.99), 'max', pct(latencies, 1));
+  console.log('status', JSON.stringify(statuses));
+}
+
+// heap and limiter counters from /metrics, WM_METRICS
+function metrics(host, port, label, cb) {
+  request(host, port, false, function (ok, ms, status, body) {
+    if (status === '200') {
+      const lines = body.split('\n').filter(function (l) {
+        return /^wm_(heap_free_bytes|heap_min_free_bytes|http_\w+) /.test(l);
+      });
+      console.log(label, lines.join(' '));
+    }
+    cb();
+  }, '/metrics');
+}
+
+const parts = target.split(':');
+const host = parts[0];
+const port = parseInt(parts[1] || '80', 10);
+metrics(host, port, 'before', function () {
+  run(host, port, function () {
+    setTimeout(function () { // let the limiter refill so the scrape is not refused
+      metrics(host, port, 'after ', function () { process.exit(0); });
+    }, 3000);
+  });
+});
@@ -0,0 +1,112 @@
+'use strict';
+
+// builds a WiFiManager runtime language pack (WM_LANGPACK) from a strings header
+// usage: node langpack.js ../wm_strings_es.h wm_es.bin [lang]
+// upload the output to the device FS and call wm.addLanguagePack(FS, "/wm_es.bin")
+
+const fs = require('fs');
+const path = require('path');
+
+const MAGIC = 'WMLP';
+const VERSION = 1;
+
+const inFile = process.argv[2];
+const outFile = process.argv[3];
+if (!inFile || !outFile) {
+  console.log('usage: node langpack.js <wm_strings_xx.h> <out.bin> [lang]');
+  process.exit(1);
+}
+
+// token ids, in order, from WM_LANGPACK_TOKENS in wm_consts_en.h
+function readTokens() {
+  const consts = fs.readFileSync(path.join(__dirname, '..', 'wm_consts_en.h'), 'utf8');
+  const block = /#define WM_LANGPACK_TOKENS\(X\)([\s\S]*?)\n\s*\n/.exec(consts);
+  if (!block) throw new Error('WM_LANGPACK_TOKENS not found in wm_consts_en.h');
+  const tokens = [];
+  const re = /X\(\s*([A-Za-z0-9_]+)\s*,\s*([^)\s]+)\s*\)/g;
+  let m;
+  while ((m = re.exec(block[1])) !== null) tokens.push({ id: m[1], src: m[2] });
+  return tokens;
+}
+
+// C string literal body to bytes
+function unescape(s) {
+  return s.replace(/\\(x[0-9a-fA-F]{1,2}|[0-7]{1,3}|.)/g, function (all, e) {
+    if (e[0] === 'x') return String.fromCharCode(parseInt(e.slice(1), 16));
+    if (/^[0-7]+$/.test(e)) return String.fromCharCode(parseInt(e, 8));
+    return { n: '\n', r: '\r', t: '\t', '0': '\0' }[e] || e;
+  });
+}
+
+// strip comments outside of literals
+function stripComments(src) {
+  return src.replace(/"(?:\\.|[^"\\])*"|\/\/[^\n]*|\/\*[\s\S]*?\*\//g, function (m) {
+    return m[0] === '"' ? m : ' ';
+  });
+}
+
+// NAME -> string, and NAME[i] -> string for arrays
+function readStrings(file) {
+  const src = stripComments(fs.readFileSync(file, 'utf8'));
+  const strings = {};
+  const re = /const\s+char\s*(\*\s*const\s+)?([A-Za-z0-9_]+)\s*\[\]\s*PROGMEM\s*=\s*([^;]*);/g;
+  let m;
+  while ((m = re.exec(src)) !== null) {
+    const name = m[2];
+    let body = m[3].trim();
+    if (m[1]) {
+      // array of literals, elements separated by commas outside quotes
+      body = body.replace(/^\{|\}$/g, '');
+      const items = body.match(/(?:"(?:\\.|[^"\\])*"\s*)+/g) || [];
+      items.forEach(function (item, i) { strings[name + '[' + i + ']'] = literal(item); });
+    } else {
+      strings[name] = literal(body);
+    }
+  }
+  return strings;
+}
+
+function literal(body) {
+  const parts = body.match(/"(?:\\.|[^"\\])*"/g) || [];
+  return parts.map(function (p) { return unescape(p.slice(1, -1)); }).join('');
+}
+
+const tokens = readTokens();
+const strings = readStrings(inFile);
+
+let lang = process.argv[4];
+if (!lang) lang = strings.WM_LANGUAGE;
+if (!lang) {
+  console.log('no WM_LANGUAGE in', inFile, ', pass lang as 3rd argument');
+  process.exit(1);
+}
+if (lang.length > 8) throw new Error('lang code too long, max 8: ' + lang);
+
+const entries = [];
+tokens.forEach(function (tok, id) {
+  const str = strings[tok.src];
+  if (str === undefined) {
+    console.log('missing', tok.id, 'falls back to compiled string');
+    return;
+  }
+  entries.push({ id: id, data: Buffer.from(str, 'utf8') });
+});
+
+// header[16] index[count * 8] data
+const header = Buffer.alloc(16);
+header.write(MAGIC, 0, 'ascii');
+header.writeUInt8(VERSION, 4);
+header.writeUInt16LE(entries.length, 6);
+header.write(lang, 8, 'ascii');
+
+const index = Buffer.alloc(entries.length * 8);
+let offset = header.length + index.length;
+entries.forEach(function (e, i) {
+  index.writeUInt16LE(e.id, i * 8);
+  index.writeUInt16LE(e.data.length, i * 8 + 2);
+  index.writeUInt32LE(offset, i * 8 + 4);
+  offset += e.data.length;
+});
+
+fs.writeFileSync(outFile, Buffer.concat([header, index].concat(entries.map(function (e) { return e.data; }))));
+console.log('wrote', outFile, lang, entries.length + '/' + tokens.length, 'strings', offset, 'bytes');
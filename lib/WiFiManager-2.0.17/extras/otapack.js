@@ -0,0 +1,30 @@
+'use strict';
+
+// compresses a firmware image for the portal updater and prints its sha256
+// usage: node otapack.js firmware.bin [firmware.bin.gz]
+// esp32 needs WM_OTA_INFLATE, esp8266 cores flash gzip images natively
+// paste the printed sha256 in the update form to have the image verified before it is activated
+
+const fs = require('fs');
+const zlib = require('zlib');
+const crypto = require('crypto');
+
+const inFile = process.argv[2];
+const outFile = process.argv[3] || inFile + '.gz';
+if (!inFile) {
+  console.log('usage: node otapack.js <firmware.bin> [out.bin.gz]');
+  process.exit(1);
+}
+
+const image = fs.readFileSync(inFile);
+if (image[0] !== 0xE9) console.log('warning:', inFile, 'does not look like an esp image');
+
+// default 32KB window, matches TINFL_LZ_DICT_SIZE on the device
+const packed = zlib.gzipSync(image, { level: 9, windowBits: 15 });
+
+// must inflate back to the same image
+if (!zlib.gunzipSync(packed).equals(image)) throw new Error('roundtrip failed');
+
+fs.writeFileSync(outFile, packed);
+console.log('wrote', outFile, image.length, '->', packed.length, 'bytes', Math.round(100 * packed.length / image.length) + '%');
+console.log('sha256', crypto.createHash('sha256').update(packed).digest('hex'));
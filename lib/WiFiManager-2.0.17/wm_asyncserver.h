@@ -0,0 +1,295 @@
+/**
+ * wm_asyncserver.h
+ * WiFiManager async web server backend, WM_ASYNCWEBSERVER
+ * Adapts ESPAsyncWebServer to the WebServer api used by the portal handlers,
+ * connections are accepted and parsed concurrently on the async_tcp task
+ * handlers do not run on async_tcp, requests are queued and handleClient() runs them one at a time on the
+ * task processing the portal, like WebServer, so scans, connects and delays in handlers can not trip its watchdog
+ * async request and response objects are not safe off async_tcp, so a handler's send() only fills a Deferred
+ * response that async_tcp picks up on its next poll of the connection, up to 500ms later
+ * upload chunks are the exception, their data is only valid in the async_tcp callback
+ * bodies are still built whole by the handlers and copied into the response, they are not streamed
+ */
+
+#ifndef _WM_ASYNCSERVER_H
+#define _WM_ASYNCSERVER_H
+
+#include <ESPAsyncWebServer.h>
+#include <functional>
+#include <vector>
+
+#ifndef WM_ASYNC_QUEUE
+#define WM_ASYNC_QUEUE 4 // requests waiting for handleClient(), more are answered 503 from async_tcp
+#endif
+
+class WiFiManagerAsyncServer {
+  public:
+    typedef std::function<void(void)> THandlerFunction;
+
+    // client proxy, for localIP(), remoteIP() and stop() on the current request
+    class Client {
+      public:
+        Client(WiFiManagerAsyncServer *server) : _server(server) {}
+        IPAddress localIP()  { return _server->get<IPAddress>([](AsyncWebServerRequest *r){ return r->client()->localIP(); }); }
+        IPAddress remoteIP() { return _server->get<IPAddress>([](AsyncWebServerRequest *r){ return r->client()->remoteIP(); }); }
+        void      stop()    {} // async closes after the response
+      private:
+        WiFiManagerAsyncServer *_server;
+    };
+
+    WiFiManagerAsyncServer(int port = 80) : _server(port), _client(this) { _lock = xSemaphoreCreateRecursiveMutex(); }
+    ~WiFiManagerAsyncServer() {
+      _server.end();
+      if(_lock) vSemaphoreDelete(_lock);
+    }
+
+    void begin()        { _server.begin(); }
+    void stop()         { _server.end(); }
+
+    // run the oldest queued handler, on the caller's task
+    void handleClient() {
+      lock();
+      if(_queued == 0){
+        unlock();
+        return;
+      }
+      Pending p = _queue[_first];
+      _first = (_first + 1) % WM_ASYNC_QUEUE;
+      _queued--;
+      _req = p.req; // NULL if its client already left
+      _res = p.res;
+      _headers.clear();
+      unlock();
+      if(p.req) p.fn();
+      lock();
+      if(_res) finish(500, "text/plain", ""); // handler sent nothing, do not leave the client waiting
+      _req = NULL;
+      unlock();
+    }
+
+    void on(const char *uri, THandlerFunction fn) {
+      _server.on(uri, (WebRequestMethodComposite)HTTP_ANY, wrap(fn));
+    }
+
+    void on(const char *uri, HTTPMethod method, THandlerFunction fn, THandlerFunction ufn) {
+      (void)method; // async method bits differ from HTTPMethod, handlers check method() themselves
+      _server.on(uri, (WebRequestMethodComposite)HTTP_ANY, wrap(fn), wrapUpload(ufn));
+    }
+
+    void onNotFound(THandlerFunction fn) { _server.onNotFound(wrap(fn)); }
+    void collectHeaders(const char* headerKeys[], const size_t headerKeysCount) {} // all headers are kept
+
+    // current request, read under the lock, the client can leave while a handler runs
+    String     uri()                           { return get<String>([](AsyncWebServerRequest *r){ return r->url(); }); }
+    HTTPMethod method()                        { return get<HTTPMethod>([](AsyncWebServerRequest *r){ return strcmp(r->methodToString(), "POST") == 0 ? HTTP_POST : HTTP_GET; }, HTTP_GET); }
+    int        args()                          { return get<int>([](AsyncWebServerRequest *r){ return (int)r->args(); }, 0); }
+    String     arg(int i)                      { return get<String>([i](AsyncWebServerRequest *r){ return r->arg((size_t)i); }); }
+    String     arg(const String &name)         { return get<String>([&name](AsyncWebServerRequest *r){ return r->arg(name); }); }
+    String     argName(int i)                  { return get<String>([i](AsyncWebServerRequest *r){ return r->argName((size_t)i); }); }
+    bool       hasArg(const String &name)      { return get<bool>([&name](AsyncWebServerRequest *r){ return r->hasArg(name.c_str()); }, false); }
+    String     header(const String &name)      { return get<String>([&name](AsyncWebServerRequest *r){ return r->header(name.c_str()); }); }
+    String     hostHeader()                    { return get<String>([](AsyncWebServerRequest *r){ return r->host(); }); }
+    Client&    client()                        { return _client; }
+    HTTPUpload& upload()                       { return _upload; }
+
+    bool authenticate(const char *user, const char *pass) {
+      return get<bool>([user, pass](AsyncWebServerRequest *r){ return r->authenticate(user, pass); }, false);
+    }
+    // basic only, a digest challenge needs the request's nonce which can not be made off async_tcp
+    void requestAuthentication(HTTPAuthMethod mode = BASIC_AUTH) {
+      (void)mode;
+      sendHeader(F("WWW-Authenticate"), F("Basic realm=\"Login Required\""));
+      send(401, "text/plain", "");
+    }
+
+    void sendHeader(const String &name, const String &value, bool first = false) {
+      (void)first;
+      _headers.push_back(name);
+      _headers.push_back(value);
+    }
+
+    // body is copied into the response and sent by async_tcp as the client's tcp window allows
+    void send(int code, const String &type, const String &content = String("")) {
+      lock();
+      finish(code, type, content);
+      unlock();
+    }
+
+    void send_P(int code, PGM_P type, PGM_P content) {
+      send(code, String(FPSTR(type)), String(FPSTR(content)));
+    }
+
+    // content may be a reused buffer that is sent after the handler returns, copy it
+    void send_P(int code, PGM_P type, const char *content, size_t len) {
+      String body;
+      body.reserve(len);
+      for(size_t i = 0; i < len; i++) body += (char)pgm_read_byte(content + i);
+      send(code, String(FPSTR(type)), body);
+    }
+
+  protected:
+    // attached to a request on async_tcp before its handler runs, async_tcp polls it until the handler filled it in
+    // then writes an ordinary response built from it, the portal task only touches the fields under the server lock
+    class Deferred : public AsyncWebServerResponse {
+      public:
+        Deferred(SemaphoreHandle_t lock) : _lock(lock) {}
+        ~Deferred() { delete _inner; }
+
+        bool                 ready = false;
+        int                  code  = 500;
+        String               type;
+        String               body;
+        std::vector<String>  headers; // name, value pairs
+
+        bool   _sourceValid() const override { return true; }
+        bool   _started() const override     { return _inner && _inner->_started(); }
+        bool   _finished() const override    { return _inner && _inner->_finished(); }
+        bool   _failed() const override      { return _inner && _inner->_failed(); }
+        void   _respond(AsyncWebServerRequest *request) override { _ack(request, 0, 0); }
+
+        // on async_tcp, from the request's ack and poll callbacks
+        size_t _ack(AsyncWebServerRequest *request, size_t len, uint32_t time) override {
+          if(_inner) return _inner->_ack(request, len, time);
+          xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+          if(ready){
+            _inner = request->beginResponse(code, type, body);
+            for(size_t i = 0; i + 1 < headers.size(); i += 2) _inner->addHeader(headers[i], headers[i + 1]);
+            body = String();
+            headers.clear();
+          }
+          xSemaphoreGiveRecursive(_lock);
+          if(_inner) _inner->_respond(request);
+          return 0;
+        }
+
+      private:
+        SemaphoreHandle_t       _lock;
+        AsyncWebServerResponse *_inner = NULL;
+    };
+
+    typedef struct {
+      AsyncWebServerRequest *req; // NULL once its client is gone
+      Deferred              *res; // owned by req
+      THandlerFunction       fn;
+    } Pending;
+
+    AsyncWebServer       _server;
+    AsyncWebServerRequest *_req = NULL; // current, NULL once its client is gone or it was answered
+    Deferred             *_res = NULL; // response of _req, NULL once its client is gone or it was answered
+    Client               _client;
+    HTTPUpload           _upload;
+    std::vector<String>  _headers; // name, value pairs for the next response
+    SemaphoreHandle_t    _lock = NULL; // recursive, _queue, _req and Deferred fields, shared with async_tcp
+    Pending              _queue[WM_ASYNC_QUEUE];
+    uint8_t              _first  = 0;
+    uint8_t              _queued = 0;
+
+    void lock()   { xSemaphoreTakeRecursive(_lock, portMAX_DELAY); }
+    void unlock() { xSemaphoreGiveRecursive(_lock); }
+
+    template<typename T, typename F>
+    T get(F f, T none = T()) {
+      lock();
+      T value = _req ? f(_req) : none;
+      unlock();
+      return value;
+    }
+
+    // under the lock, hand the response of the current request to async_tcp
+    void finish(int code, const String &type, const String &content) {
+      if(_res){
+        _res->code    = code;
+        _res->type    = type;
+        _res->body    = content;
+        _res->headers = std::move(_headers);
+        _res->ready   = true;
+      }
+      _headers.clear();
+      _req = NULL;
+      _res = NULL;
+    }
+
+    // async_tcp frees the request when its client disconnects, drop every reference to it first
+    void forget(AsyncWebServerRequest *request) {
+      lock();
+      for(uint8_t i = 0; i < _queued; i++){
+        Pending &p = _queue[(_first + i) % WM_ASYNC_QUEUE];
+        if(p.req == request){
+          p.req = NULL;
+          p.res = NULL;
+        }
+      }
+      if(_req == request){
+        _req = NULL;
+        _res = NULL;
+      }
+      unlock();
+    }
+
+    // on async_tcp, attach a Deferred response and queue the request for handleClient()
+    ArRequestHandlerFunction wrap(THandlerFunction fn) {
+      return [this, fn](AsyncWebServerRequest *request) {
+        lock();
+        if(_queued >= WM_ASYNC_QUEUE){
+          unlock();
+          request->send(503, "text/plain", "busy");
+          return;
+        }
+        Deferred *res = new Deferred(_lock);
+        request->onDisconnect([this, request]() { forget(request); });
+        request->send(res);
+        _queue[(_first + _queued) % WM_ASYNC_QUEUE] = {request, res, fn};
+        _queued++;
+        unlock();
+      };
+    }
+
+    // async delivers body chunks as they arrive, replayed to the handler as HTTPUpload start/write/end on async_tcp
+    // the lock is held so a handler running in handleClient() does not see this request as current
+    ArUploadHandlerFunction wrapUpload(THandlerFunction ufn) {
+      return [this, ufn](AsyncWebServerRequest *request, const String &filename, size_t index, uint8_t *data, size_t len, bool final) {
+        lock();
+        AsyncWebServerRequest *current = _req;
+        Deferred *currentres = _res;
+        _req = request;
+        _res = NULL; // nothing is sent from an upload chunk
+        if(index == 0){
+          _upload.status      = UPLOAD_FILE_START;
+          _upload.filename    = filename;
+          _upload.name        = filename;
+          _upload.type        = request->contentType();
+          _upload.totalSize   = 0;
+          _upload.currentSize = 0;
+          ufn();
+          request->onDisconnect([this, ufn, request]() {
+            forget(request);
+            if(_upload.status == UPLOAD_FILE_END) return;
+            lock();
+            _upload.status = UPLOAD_FILE_ABORTED;
+            ufn();
+            unlock();
+          });
+        }
+        while(len){
+          size_t n = len < HTTP_UPLOAD_BUFLEN ? len : HTTP_UPLOAD_BUFLEN;
+          memcpy(_upload.buf, data, n);
+          _upload.status       = UPLOAD_FILE_WRITE;
+          _upload.currentSize  = n;
+          _upload.totalSize   += n;
+          ufn();
+          data += n;
+          len  -= n;
+        }
+        if(final){
+          _upload.status      = UPLOAD_FILE_END;
+          _upload.currentSize = 0;
+          ufn();
+        }
+        _req = current;
+        _res = currentres;
+        unlock();
+      };
+    }
+};
+
+#endif
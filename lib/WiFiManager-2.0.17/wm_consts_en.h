@@ -51,6 +51,7 @@ const char R_wifi[]               PROGMEM = "/wifi";
 const char R_wifinoscan[]         PROGMEM = "/0wifi";
 const char R_wifisave[]           PROGMEM = "/wifisave";
 const char R_info[]               PROGMEM = "/info";
+const char R_infojson[]           PROGMEM = "/info.json";
 const char R_param[]              PROGMEM = "/param";
 const char R_paramsave[]          PROGMEM = "/paramsave";
 const char R_restart[]            PROGMEM = "/restart";
@@ -60,6 +61,9 @@ const char R_erase[]              PROGMEM = "/erase";
 const char R_status[]             PROGMEM = "/status";
 const char R_update[]             PROGMEM = "/update";
 const char R_updatedone[]         PROGMEM = "/u";
+const char R_statusjson[]         PROGMEM = "/status.json";
+const char R_metrics[]            PROGMEM = "/metrics";
+const char R_events[]             PROGMEM = "/events.bin";
 
 
 //Strings
@@ -92,10 +96,74 @@ const char T_r[]                  PROGMEM = "{r}"; // @token r
 const char T_R[]                  PROGMEM = "{R}"; // @token R
 const char T_h[]                  PROGMEM = "{h}"; // @token h
 
+// language pack tokens
+// ids are stable, append only, packs built by extras/langpack.js reference these by position
+// X(id, compiled default)
+#define WM_LANGPACK_TOKENS(X) \
+  X(HTTP_HEAD_START,     HTTP_HEAD_START)     \
+  X(HTTP_FORM_WIFI,      HTTP_FORM_WIFI)      \
+  X(HTTP_FORM_END,       HTTP_FORM_END)       \
+  X(HTTP_SCAN_LINK,      HTTP_SCAN_LINK)      \
+  X(HTTP_SAVED,          HTTP_SAVED)          \
+  X(HTTP_PARAMSAVED,     HTTP_PARAMSAVED)     \
+  X(HTTP_ERASEBTN,       HTTP_ERASEBTN)       \
+  X(HTTP_UPDATEBTN,      HTTP_UPDATEBTN)      \
+  X(HTTP_BACKBTN,        HTTP_BACKBTN)        \
+  X(HTTP_STATUS_ON,      HTTP_STATUS_ON)      \
+  X(HTTP_STATUS_OFF,     HTTP_STATUS_OFF)     \
+  X(HTTP_STATUS_OFFPW,   HTTP_STATUS_OFFPW)   \
+  X(HTTP_STATUS_OFFNOAP, HTTP_STATUS_OFFNOAP) \
+  X(HTTP_STATUS_OFFFAIL, HTTP_STATUS_OFFFAIL) \
+  X(HTTP_STATUS_NONE,    HTTP_STATUS_NONE)    \
+  X(HTTP_HELP,           HTTP_HELP)           \
+  X(HTTP_UPDATE,         HTTP_UPDATE)         \
+  X(HTTP_UPDATE_FAIL,    HTTP_UPDATE_FAIL)    \
+  X(HTTP_UPDATE_SUCCESS, HTTP_UPDATE_SUCCESS) \
+  X(HTTP_PORTAL_MENU_0,  HTTP_PORTAL_MENU[0]) \
+  X(HTTP_PORTAL_MENU_1,  HTTP_PORTAL_MENU[1]) \
+  X(HTTP_PORTAL_MENU_2,  HTTP_PORTAL_MENU[2]) \
+  X(HTTP_PORTAL_MENU_3,  HTTP_PORTAL_MENU[3]) \
+  X(HTTP_PORTAL_MENU_4,  HTTP_PORTAL_MENU[4]) \
+  X(HTTP_PORTAL_MENU_5,  HTTP_PORTAL_MENU[5]) \
+  X(HTTP_PORTAL_MENU_6,  HTTP_PORTAL_MENU[6]) \
+  X(HTTP_PORTAL_MENU_7,  HTTP_PORTAL_MENU[7]) \
+  X(HTTP_PORTAL_MENU_8,  HTTP_PORTAL_MENU[8]) \
+  X(HTTP_PORTAL_MENU_9,  HTTP_PORTAL_MENU[9]) \
+  X(S_y,                 S_y)                 \
+  X(S_n,                 S_n)                 \
+  X(S_passph,            S_passph)            \
+  X(S_titlewifisaved,    S_titlewifisaved)    \
+  X(S_titlewifisettings, S_titlewifisettings) \
+  X(S_titlewifi,         S_titlewifi)         \
+  X(S_titleinfo,         S_titleinfo)         \
+  X(S_titleparam,        S_titleparam)        \
+  X(S_titleparamsaved,   S_titleparamsaved)   \
+  X(S_titleexit,         S_titleexit)         \
+  X(S_titlereset,        S_titlereset)        \
+  X(S_titleerase,        S_titleerase)        \
+  X(S_titleclose,        S_titleclose)        \
+  X(S_options,           S_options)           \
+  X(S_nonetworks,        S_nonetworks)        \
+  X(S_staticip,          S_staticip)          \
+  X(S_staticgw,          S_staticgw)          \
+  X(S_staticdns,         S_staticdns)         \
+  X(S_subnet,            S_subnet)            \
+  X(S_exiting,           S_exiting)           \
+  X(S_resetting,         S_resetting)         \
+  X(S_closing,           S_closing)           \
+  X(S_error,             S_error)             \
+  X(S_notfound,          S_notfound)
+
+const char WM_LANGPACK_MAGIC[]    PROGMEM = "WMLP"; // language pack file magic
+const uint8_t WM_LANGPACK_VERSION         = 1;
+
 // http
 const char HTTP_HEAD_CL[]         PROGMEM = "Content-Length";
 const char HTTP_HEAD_CT[]         PROGMEM = "text/html";
 const char HTTP_HEAD_CT2[]        PROGMEM = "text/plain";
+const char HTTP_HEAD_CTJSON[]     PROGMEM = "application/json";
+const char HTTP_HEAD_CTPROM[]     PROGMEM = "text/plain; version=0.0.4";
+const char HTTP_HEAD_CTBIN[]      PROGMEM = "application/octet-stream";
 const char HTTP_HEAD_CORS[]       PROGMEM = "Access-Control-Allow-Origin";
 const char HTTP_HEAD_CORS_ALLOW_ALL[]  PROGMEM = "*";
 
@@ -6,13 +6,23 @@
 #include <WiFiManager.h>  //https://github.com/tzapu/WiFiManager
 #include <SPIFFS.h>
 #include <ArduinoJson.h>
-#include <PubSubClient.h>
+#include <MqttStream.h>
+#include <MqttTls.h>
 #include <Button2.h>
 #include <ezLED.h>
 #include <TickTwo.h>
+#include <lwip/sockets.h>
+#include "telemetry.h"
+#if CONFIG_PM_ENABLE
+#include <esp_pm.h>
+#endif
 
 //******************************** Configulation ****************************//
-#define _DEBUG_  // Comment this line if you don't want to debug
+#define _DEBUG_       // Comment this line if you don't want to debug
+#define _EVENT_LOOP_  // Comment this line to busy poll in loop() instead of sleeping between events
+#define _POWER_SAVE_ WIFI_PS_MAX_MODEM  // Comment this line to keep the radio awake, eg. on mains power
+#define _TELEMETRY_CBOR_                // Comment this line to publish telemetry as JSON
+//#define _MQTT_TLS_  // Uncomment this line to connect to the broker over TLS on 8883, the CA is read from /ca.pem
 
 //******************************** Variables & Objects **********************//
 #define deviceName "MyESP32"
@@ -28,7 +38,11 @@ Button2 resetWifiBt;
 
 //----------------- WiFi Manager --------------//
 char mqttBroker[16] = "192.168.0.10";
-char mqttPort[6]    = "1883";
+#ifdef _MQTT_TLS_
+char mqttPort[6] = "8883";
+#else
+char mqttPort[6] = "1883";
+#endif
 char mqttUser[10];
 char mqttPass[10];
 
@@ -40,8 +54,46 @@ WiFiManagerParameter customMqttUser("user", "mqtt user", mqttUser, 10);
 WiFiManagerParameter customMqttPass("pass", "mqtt pass", mqttPass, 10);
 
 //----------------- MQTT ----------------------//
-WiFiClient   espClient;
-PubSubClient mqtt(espClient);
+#ifdef _MQTT_TLS_
+MqttTls espClient;  // certificates parsed once, the session is resumed on reconnect and after deep sleep
+RTC_DATA_ATTR uint8_t tlsSession[MQTT_TLS_SESSION_CACHE];
+#else
+WiFiClient espClient;
+#endif
+MqttStream mqtt(espClient);  // streams packets from caller memory, no packet buffer size limit
+
+// config blob received on deviceName "/config/set", applied on the next restart
+File   configBlob;
+size_t configBlobWritten;  // bytes the file accepted, a short write means a full FS
+
+//----------------- Alarms --------------------//
+// QoS 1 on deviceName "/alarm", queued while the broker is unreachable and sent again until acked
+#define ALARM_SLOTS  4   // also the mqtt inflight window
+#define ALARM_LENGTH 48
+
+struct Alarm {
+    uint16_t packetId;  // 0 when the slot is free
+    char     text[ALARM_LENGTH];
+};
+Alarm alarms[ALARM_SLOTS];  // the client sends from here, a slot is held until its PUBACK
+
+//----------------- Telemetry -----------------//
+#define TELEMETRY_INTERVAL 60000  // ms
+#ifdef _TELEMETRY_CBOR_
+#define TELEMETRY_FORMAT TELEMETRY_CBOR
+#else
+#define TELEMETRY_FORMAT TELEMETRY_JSON
+#endif
+
+// published to deviceName "/telemetry", add fields here
+#define DEVICE_TELEMETRY(X) \
+    X(uint32_t, uptime)     \
+    X(int32_t, rssi)        \
+    X(uint32_t, heap)       \
+    X(uint32_t, awake)
+TELEMETRY_STRUCT(DeviceTelemetry, DEVICE_TELEMETRY);
+
+uint8_t telemetryBuf[96];  // encoded in place, no allocation per publish
 
 //******************************** Tasks ************************************//
 // void    mqttStateDetector();
@@ -52,6 +104,36 @@ void    reconnectMqtt();
 TickTwo tConnectMqtt(connectMqtt, 0, 0, MILLIS);  // (function, interval, iteration, interval unit)
 TickTwo tReconnectMqtt(reconnectMqtt, 3000, 0, MILLIS);
 
+void    publishTelemetry();
+TickTwo tPublishTelemetry(publishTelemetry, TELEMETRY_INTERVAL, 0, MILLIS);
+
+#ifdef _EVENT_LOOP_
+#define MQTT_LOOP_INTERVAL 1000  // keepalive check, incoming packets wake loop() from the socket watcher
+#else
+#define MQTT_LOOP_INTERVAL 0
+#endif
+#define MQTT_KEEPALIVE 60  // s, pings are sent from the keepalive check, on a radio wakeup when power save is on
+
+//----------------- Scheduler -----------------//
+// loop() sleeps until the next timer is due or a wifi, button, portal or mqtt socket event wakes it
+#define LOOP_SLEEP_MAX    1000   // ms, longest sleep
+#define LOOP_POLL_INTERVAL 10    // ms, while the led is blinking or the button is in use
+#define BUTTON_ACTIVE_TIME 1500  // ms after a button edge, for Button2 debounce and click detection
+#define LOOP_STATS_INTERVAL 60000  // duty cycle is reported as awake ms per minute
+
+TaskHandle_t      loopTaskHandle;
+TaskHandle_t      mqttWatchTaskHandle;
+volatile uint32_t lastButtonEdge;
+volatile int      mqttFd = -1;
+
+// loop stats, wakeups per second and time spent asleep
+uint32_t loopWakeups;
+uint32_t loopSleepTime;  // us
+uint32_t loopStatsStart;
+float    loopWakeupRate;
+float    loopIdlePercent;
+uint32_t loopAwakeTime;  // ms per minute, loop task not blocked
+
 //******************************** Functions ********************************//
 //----------------- SPIFFS --------------------//
 void loadConfigration() {
@@ -108,12 +190,76 @@ void loadConfigration() {
     }
 }
 
+// gauge on /status.json and /metrics, WM_METRICS_USER in platformio.ini must cover every one
+void addMetric(const char* name, std::function<int32_t()> func) {
+    if (!wifiManager.addMetric(name, func)) {
+#ifdef _DEBUG_
+        Serial.printf("metric %s not added, raise WM_METRICS_USER\n", name);
+#endif
+    }
+}
+
+// binary event log, decode with lib/WiFiManager-2.0.17/extras/eventlog.js
+void publishEventLog() {
+    static uint8_t buf[sizeof(wm_eventhdr_t) + WM_EVENTLOG_SIZE * sizeof(wm_eventrec_t)];
+    size_t         len = wifiManager.readEventLog(buf, sizeof(buf));
+    mqtt.publish(deviceName "/events", buf, len);  // written from buf, not copied
+}
+
+// log mqtt state changes to the event log
+void logMqttState() {
+    static int lastState = MQTT_DISCONNECTED;
+    int        state     = mqtt.state();
+    if (state != lastState) {
+        wifiManager.logEvent(WM_EV_MQTT_STATE, 0, state);
+        lastState = state;
+    }
+}
+
+// called with the whole payload, or piece by piece when it is larger than MQTT_STREAM_BUFFER
+void receiveConfigBlob(const uint8_t* data, size_t length, size_t offset, size_t total) {
+    if (offset == 0) {
+        if (configBlob) configBlob.close();
+        configBlob        = SPIFFS.open("/config.json.new", "w");
+        configBlobWritten = 0;
+    }
+    if (!configBlob) return;
+    configBlobWritten += configBlob.write(data, length);
+    if (offset + length < total) return;
+
+    bool complete = configBlobWritten == total;
+    configBlob.close();
+    if (complete) {
+        SPIFFS.remove("/config.json");  // rename does not replace an existing file
+        complete = SPIFFS.rename("/config.json.new", "/config.json");
+    }
+#ifdef _DEBUG_
+    Serial.printf("config blob %u bytes %s\n", (unsigned)total, complete ? "saved" : "failed");
+#endif
+}
+
+void handleMqttFragment(const char* topic, const uint8_t* data, size_t length, size_t offset, size_t total) {
+    if (strcmp(topic, deviceName "/config/set") == 0) {
+        receiveConfigBlob(data, length, offset, total);
+    }
+}
+
 void handleMqttMessage(char* topic, byte* payload, unsigned int length) {
+    if (strcmp(topic, deviceName "/config/set") == 0) {
+        receiveConfigBlob(payload, length, 0, length);
+        return;
+    }
+
     String message;
     for (int i = 0; i < length; i++) {
         message += (char)payload[i];
     }
 
+    if (String(topic) == deviceName "/events/get") {
+        publishEventLog();
+        return;
+    }
+
     if (String(topic) == "test/subscribe/topic") {
         if (message == "aValue") {
             // Do something
@@ -123,6 +269,59 @@ void handleMqttMessage(char* topic, byte* payload, unsigned int length) {
     }
 }
 
+bool publishAlarm(const char* text) {
+    for (Alarm& alarm : alarms) {
+        if (alarm.packetId) continue;
+        strlcpy(alarm.text, text, sizeof(alarm.text));
+        if (!mqtt.publish(deviceName "/alarm", (const uint8_t*)alarm.text, strlen(alarm.text), false, 1)) return false;
+        alarm.packetId = mqtt.lastPacketId();
+        return true;
+    }
+    return false;  // every slot is waiting for an ack
+}
+
+void handleMqttAck(uint16_t packetId, bool acked) {
+    for (Alarm& alarm : alarms) {
+        if (alarm.packetId == packetId) alarm.packetId = 0;
+    }
+#ifdef _DEBUG_
+    if (!acked) Serial.printf("mqtt publish %u dropped\n", packetId);
+#endif
+}
+
+// an abnormal reset is reported once the broker is reachable
+void publishResetAlarm() {
+    esp_reset_reason_t reason = esp_reset_reason();
+    if (reason == ESP_RST_PANIC || reason == ESP_RST_INT_WDT || reason == ESP_RST_TASK_WDT || reason == ESP_RST_WDT ||
+        reason == ESP_RST_BROWNOUT) {
+        char text[ALARM_LENGTH];
+        snprintf(text, sizeof(text), "reset reason %d", (int)reason);
+        publishAlarm(text);
+    }
+}
+
+#ifdef _MQTT_TLS_
+// from SPIFFS, /client.crt and /client.key only when the broker wants client certificates
+void tlsInit() {
+    bool clientCert = SPIFFS.exists("/client.crt");
+    if (!espClient.loadCredentials(SPIFFS, "/ca.pem", clientCert ? "/client.crt" : NULL, "/client.key")) {
+#ifdef _DEBUG_
+        Serial.printf("TLS credentials not loaded, error -0x%04x\n", -espClient.lastError());
+#endif
+    }
+    espClient.setSessionCache(tlsSession, sizeof(tlsSession));
+}
+#endif
+
+void subscribeMqtt() {
+#ifdef _DEBUG_
+    Serial.println(F("Subscribing to the MQTT topics..."));
+#endif
+    mqtt.subscribe("test/subscribe/topic");
+    mqtt.subscribe(deviceName "/events/get");
+    mqtt.subscribe(deviceName "/config/set", 1);
+}
+
 void mqttInit() {
 #ifdef _DEBUG_
     Serial.print(F("MQTT parameters are "));
@@ -132,7 +331,13 @@ void mqttInit() {
         Serial.println(F(" available"));
 #endif
         mqtt.setServer(mqttBroker, atoi(mqttPort));
+        mqtt.setKeepAlive(MQTT_KEEPALIVE);
         mqtt.setCallback(handleMqttMessage);
+        mqtt.setFragmentCallback(handleMqttFragment);
+        mqtt.setAckCallback(handleMqttAck);
+        mqtt.setCleanSession(false);  // subscriptions and unacked QoS 1 publishes survive a reconnect
+        mqtt.setInflightWindow(ALARM_SLOTS);
+        subscribeMqtt();  // remembered by the client, batched into one SUBSCRIBE on connect
         tConnectMqtt.start();
     } else {
 #ifdef _DEBUG_
@@ -213,15 +418,42 @@ void wifiManagerSetup() {
     wifiManager.setDarkMode(true);
     // wifiManager.setConfigPortalTimeout(60);  // auto close configportal after 30 seconds
     wifiManager.setConfigPortalBlocking(false);
+    wifiManager.setPortalTask(true, 0);  // serve the portal from core 0, loop() keeps running on core 1
+    wifiManager.setFastConnect(true);  // reconnect to the last bssid/channel without scanning
+    wifiManager.setRoaming(true);      // move to a stronger ap of the same ssid in the background
+#ifdef _POWER_SAVE_
+    wifiManager.setPowerSave(_POWER_SAVE_);  // modem sleep between beacons, off while the config portal runs
+#endif
+#ifdef _DEBUG_
+    wifiManager.setRoamCallback([](const wm_roam_event_t& e) {
+        Serial.printf("Roam %s: %d -> %d dBm, ch %u, %lu ms\n", e.success ? "ok" : "failed", e.fromRssi, e.toRssi,
+                      e.channel, (unsigned long)e.downtime);
+    });
+    wifiManager.setPortalReadyCallback(
+        []() { Serial.printf("Configportal ready in %lu ms\n", wifiManager.getPortalReadyTime()); });
+#endif
 #ifdef _DEBUG_
     Serial.println(F("Saving configuration..."));
 #endif
     wifiManager.setSaveConfigCallback(saveConfigCallback);
+    wifiManager.setEventLogSpill(SPIFFS, "/events.log", 8192);  // keep events across restarts, /events.bin?file=1
+
+    // fleet scraping, /status.json and /metrics
+    addMetric("mqtt_connected", []() { return (int32_t)(mqtt.state() == MQTT_CONNECTED); });
+    addMetric("mqtt_state", []() { return (int32_t)mqtt.state(); });
+    addMetric("mqtt_inflight", []() { return (int32_t)mqtt.inflight(); });
+#ifdef _MQTT_TLS_
+    addMetric("mqtt_tls_handshake_ms", []() { return (int32_t)espClient.handshakeTime(); });
+    addMetric("mqtt_tls_heap", []() { return (int32_t)espClient.handshakeHeap(); });
+    addMetric("mqtt_tls_resumed", []() { return (int32_t)espClient.resumed(); });
+#endif
 
     if (wifiManager.autoConnect(deviceName, "password")) {
 #ifdef _DEBUG_
         Serial.println(F("WiFi is connected :D"));
+        Serial.printf("Connected in %lu ms\n", wifiManager.getLastConxTime());
 #endif
+        wifiManager.startWebPortal(true);  // only status and metrics on the station ip, no config pages or ota
     } else {
 #ifdef _DEBUG_
         Serial.println(F("Configportal running"));
@@ -229,41 +461,71 @@ void wifiManagerSetup() {
     }
 }
 
-void subscribeMqtt() {
+void publishMqtt() {
 #ifdef _DEBUG_
-    Serial.println(F("Subscribing to the MQTT topics..."));
+    Serial.println(F("Publishing to the MQTT topics..."));
 #endif
-    mqtt.subscribe("test/subscribe/topic");
+    mqtt.publish("test/publish/topic", "Hello World!");
 }
 
-void publishMqtt() {
+void publishTelemetry() {
+    DeviceTelemetry telemetry;
+    telemetry.uptime = millis() / 1000;
+    telemetry.rssi   = WiFi.RSSI();
+    telemetry.heap   = ESP.getFreeHeap();
+    telemetry.awake  = loopAwakeTime;
+
+    size_t len = telemetry.encode(telemetryBuf, sizeof(telemetryBuf), TELEMETRY_FORMAT);
+    if (len) {
+        mqtt.publish(deviceName "/telemetry", telemetryBuf, len);
+    } else {
 #ifdef _DEBUG_
-    Serial.println(F("Publishing to the MQTT topics..."));
+        Serial.println(F("telemetryBuf is too small"));
 #endif
-    mqtt.publish("test/publish/topic", "Hello World!");
+    }
 }
 
 //----------------- Connect MQTT --------------//
+// keepalive checks and publishes go out when the radio wakes for a beacon anyway
+uint32_t alignToRadio(uint32_t interval) {
+#ifdef _POWER_SAVE_
+    return wifiManager.alignToPowerSave(interval);
+#else
+    return interval;
+#endif
+}
+
 void reconnectMqtt() {
     if (WiFi.status() == WL_CONNECTED) {
 #ifdef _DEBUG_
         Serial.println(F("Connecting MQTT... "));
 #endif
-        if (mqtt.connect(deviceName, mqttUser, mqttPass)) {
+        bool connected = mqtt.connect(deviceName, mqttUser, mqttPass);
+        logMqttState();
+        if (connected) {
+            espClient.setNoDelay(true);  // packets are written whole, do not hold the last segment back for an ack
             tReconnectMqtt.stop();
             Serial.printf("tReconnectMqtt, counter: %d\n", tReconnectMqtt.counter());
 #ifdef _DEBUG_
-            Serial.println(F("Connected"));
+            Serial.println(mqtt.sessionPresent() ? F("Connected, session resumed") : F("Connected, new session"));
+#ifdef _MQTT_TLS_
+            Serial.printf("TLS %s handshake in %lu ms, %lu bytes heap\n", espClient.resumed() ? "resumed" : "full",
+                          (unsigned long)espClient.handshakeTime(), (unsigned long)espClient.handshakeHeap());
+#endif
 #endif
-            tConnectMqtt.interval(0);
+            tConnectMqtt.interval(alignToRadio(MQTT_LOOP_INTERVAL));
             tConnectMqtt.start();
+            tPublishTelemetry.interval(alignToRadio(TELEMETRY_INTERVAL));
+            tPublishTelemetry.start();
             statusLed.blinkNumberOfTimes(200, 200, 3);  // 200ms ON, 200ms OFF, repeat 3 times, blink immediately
-            subscribeMqtt();
-            publishMqtt();
+            publishMqtt();  // subscriptions are sent by the client, only when the broker lost the session
         } else {
 #ifdef _DEBUG_
             Serial.print(F("failed state: "));
             Serial.println(mqtt.state());
+#ifdef _MQTT_TLS_
+            Serial.printf("TLS error -0x%04x\n", -espClient.lastError());
+#endif
             Serial.print(F("counter: "));
             Serial.println(tReconnectMqtt.counter());
 #endif
@@ -283,15 +545,106 @@ void reconnectMqtt() {
 }
 
 void connectMqtt() {
+    logMqttState();
     if (!mqtt.connected()) {
         Serial.printf("tConnectMqtt, counter: %d\n", tConnectMqtt.counter());
         tConnectMqtt.stop();
+        tPublishTelemetry.stop();
         tReconnectMqtt.start();
     } else {
         mqtt.loop();
     }
 }
 
+//----------------- Scheduler -----------------//
+void wakeLoop() {
+    if (loopTaskHandle) xTaskNotifyGive(loopTaskHandle);
+}
+
+void IRAM_ATTR resetWifiBtEdge() {
+    BaseType_t woken = pdFALSE;
+    lastButtonEdge   = millis();
+    vTaskNotifyGiveFromISR(loopTaskHandle, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+// wakes loop() when the mqtt socket is readable, then waits for loop() to read it before selecting again
+void mqttWatchTask(void* arg) {
+    for (;;) {
+        int fd = mqttFd;
+        if (fd < 0) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);  // no connection, wait for loop() to hand one over
+            continue;
+        }
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        FD_SET(fd, &readSet);
+        timeval timeout = {1, 0};  // pick up a changed fd
+        int     res     = select(fd + 1, &readSet, NULL, NULL, &timeout);
+        if (res > 0) {
+            wakeLoop();
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        } else if (res < 0) {
+            vTaskDelay(pdMS_TO_TICKS(100));  // closed under us, loop() will hand over the new fd
+        }
+    }
+}
+
+// read what the socket watcher woke us for and hand the current fd back to it
+void serviceMqtt() {
+    int fd = mqtt.connected() ? espClient.fd() : -1;
+    for (uint8_t i = 0; fd >= 0 && i < 8 && espClient.available(); i++) mqtt.loop();
+    mqttFd = fd;
+    xTaskNotifyGive(mqttWatchTaskHandle);
+}
+
+// ms until something in loop() is due
+uint32_t loopNextWake() {
+    uint32_t wait = min((unsigned long)LOOP_SLEEP_MAX, wifiManager.getProcessDelay());
+    if (tConnectMqtt.state() == RUNNING) wait = min(wait, tConnectMqtt.remaining());
+    if (tReconnectMqtt.state() == RUNNING) wait = min(wait, tReconnectMqtt.remaining());
+    if (tPublishTelemetry.state() == RUNNING) wait = min(wait, tPublishTelemetry.remaining());
+    if (statusLed.getState() != LED_IDLE || resetWifiBt.isPressed() || millis() - lastButtonEdge < BUTTON_ACTIVE_TIME) {
+        wait = min(wait, (uint32_t)LOOP_POLL_INTERVAL);
+    }
+    return wait;
+}
+
+void loopStats(uint32_t sleepTime) {
+    loopWakeups++;
+    loopSleepTime += sleepTime;
+    uint32_t elapsed = millis() - loopStatsStart;
+    if (elapsed < LOOP_STATS_INTERVAL) return;
+    loopWakeupRate  = loopWakeups * 1000.0f / elapsed;
+    loopIdlePercent = loopSleepTime / (elapsed * 10.0f);
+    loopAwakeTime   = (uint32_t)((elapsed - min(elapsed, loopSleepTime / 1000)) * 60000ULL / elapsed);
+#ifdef _DEBUG_
+    Serial.printf("loop: %.1f wakeups/s, %.1f%% idle, awake %lu ms/min\n", loopWakeupRate, loopIdlePercent,
+                  (unsigned long)loopAwakeTime);
+#endif
+    loopWakeups    = 0;
+    loopSleepTime  = 0;
+    loopStatsStart = millis();
+}
+
+void schedulerSetup() {
+    loopTaskHandle = xTaskGetCurrentTaskHandle();
+#ifdef _EVENT_LOOP_
+    attachInterrupt(digitalPinToInterrupt(resetWifiBtPin), resetWifiBtEdge, CHANGE);
+    WiFi.onEvent([](arduino_event_id_t event, arduino_event_info_t info) { wakeLoop(); });
+    wifiManager.setProcessWakeCallback(wakeLoop);
+    xTaskCreatePinnedToCore(mqttWatchTask, "mqttWatch", 2048, NULL, 1, &mqttWatchTaskHandle, 1);
+#endif
+    addMetric("loop_wakeups", []() { return (int32_t)loopWakeupRate; });
+    addMetric("loop_idle_pct", []() { return (int32_t)loopIdlePercent; });
+    addMetric("loop_awake_ms_per_min", []() { return (int32_t)loopAwakeTime; });
+#if defined(_POWER_SAVE_) && CONFIG_PM_ENABLE && CONFIG_FREERTOS_USE_TICKLESS_IDLE
+    // automatic light sleep while loop() and the other tasks are blocked, needs a pm enabled sdkconfig
+    esp_pm_config_esp32_t pm = {240, 80, true};  // max MHz, min MHz, light sleep
+    esp_pm_configure(&pm);
+#endif
+}
+
 //----------------- Reset WiFi Button ---------//
 void resetWifiBtPressed(Button2& btn) {
     statusLed.turnON();
@@ -317,7 +670,12 @@ void setup() {
     resetWifiBt.setLongClickDetectedHandler(resetWifiBtPressed);
 
     wifiManagerSetup();
+#ifdef _MQTT_TLS_
+    tlsInit();
+#endif
     mqttInit();
+    publishResetAlarm();
+    schedulerSetup();
 }
 
 //********************************  Loop ************************************//
@@ -327,4 +685,14 @@ void loop() {
     wifiManager.process();
     tConnectMqtt.update();
     tReconnectMqtt.update();
+    tPublishTelemetry.update();
+#ifdef _EVENT_LOOP_
+    serviceMqtt();
+    uint32_t wait  = loopNextWake();
+    uint32_t start = micros();
+    if (wait) ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait));
+    loopStats(micros() - start);
+#else
+    loopStats(0);
+#endif
 }